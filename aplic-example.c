@@ -22,12 +22,33 @@
 #include <metal/machine/inline.h>
 
 #include "interrupts.h"
+#include "vector_table.h"
+#include "timer.h"
+#include "clocksource.h"
+#include "aplic_registry.h"
+#include "aplic_cluster.h"
+#include "boot_profile.h"
+#include "executor.h"
+#include "exception.h"
+#include "interrupt_stack.h"
+#include "console.h"
+#include "aplic_shadow.h"
+#include "fast_irq.h"
+#include "jitter.h"
+#include "fanout.h"
+#include "aplic_tune.h"
+#include "beu_log.h"
+#include "misaligned.h"
+#include "ipi.h"
 
 /* !!!!! ALERT: This can be different per IP package, make sure it's right for you !!!!!!! */
 #if defined(METAL_SIFIVE_EXTENSIBLECACHE0)
 #define EC_INTERRUPT_ID        0x1
 #endif
 
+/* Time until the timer interrupt fires in the timer test */
+#define TIMER_TEST_DELAY_US    100
+
 /* Globals */
 volatile int harts_continue = 0;
 volatile int checkin_count = 0;
@@ -47,29 +68,59 @@ uint32_t beu_accrued_value = 0;
  */
 void metal_init_run() {
 
+    boot_profile_stamp(metal_cpu_get_current_hartid(), BOOT_PHASE_METAL_INIT);
+
     /* There is extensible cache init, chicken bit, and tty init done here */
 }
 
 void metal_secondary_init_run() {
-    
+
+    boot_profile_stamp(metal_cpu_get_current_hartid(), BOOT_PHASE_METAL_INIT);
+
     /* L2 cache init and prefetcher init done here. See init.c if you need this */
 }
 
-/* Create array of function pointers for global minor (PLIC) interrupts */
-void (*aplic_minor_func[TOTAL_EXT_INTERRUPTS])(void);
-
 /* global to keep track of boot hart as defined by our linker script */
 uintptr_t boot_hart;
 
+#if BEU0_PRESENT
+/* APLIC sources enabled at boot. With PARALLEL_INIT, each hart programs its share of this table */
+static const struct aplic_source_config boot_sources[] = {
+    { BUSERR0_INT_NUM, APLIC_SOURCECFG_MODE_RISE_EDGE, PRIO_THRESH_2, MACHINE_INTS },
+    { BUSERR1_INT_NUM, APLIC_SOURCECFG_MODE_RISE_EDGE, PRIO_THRESH_2, MACHINE_INTS },
+    { BUSERR2_INT_NUM, APLIC_SOURCECFG_MODE_RISE_EDGE, PRIO_THRESH_2, MACHINE_INTS },
+    { BUSERR3_INT_NUM, APLIC_SOURCECFG_MODE_RISE_EDGE, PRIO_THRESH_2, MACHINE_INTS },
+};
+#define BOOT_SOURCES_COUNT     (sizeof(boot_sources) / sizeof(boot_sources[0]))
+#endif
+
+/* Number of work items deferred to the executor in the executor test */
+#define EXECUTOR_TEST_ITEMS         16
+
+/* Items of the executor test completed. Not on main's stack, other harts may still run an item when main returns */
+static volatile uint32_t executor_test_done = 0;
+
+/* Work item for the executor test */
+static void executor_test_work (void *arg) {
+
+    __atomic_fetch_add((volatile uint32_t *)arg, 1, __ATOMIC_RELAXED);
+}
+
+/* Time to wait for all harts to finish their share of a parallel init */
+#define PARALLEL_INIT_TIMEOUT_US    10000
+
 int main(void) {
 
     uint32_t i, mode = MTVEC_MODE_CLINT_VECTORED, retry;
-    uint32_t simulate_beu_error, countdown, mtvec_base, context_id, return_code = 0;
+    uint32_t simulate_beu_error, mtvec_base, context_id, return_code = 0;
     uintptr_t mip_csr;
+    uint64_t deadline;
 
     /* Get local hartid for every hart running this code */
     int hartid = metal_cpu_get_current_hartid();
 
+    boot_profile_stamp(hartid, BOOT_PHASE_MAIN);
+
     /* assign our boot hart location to a variable. It's OK if all harts run this code */
     boot_hart = (uintptr_t)&__metal_boot_hart;
 
@@ -85,12 +136,37 @@ int main(void) {
      * Refer to handlers.S for the vector table. The mtvec.mode
      * field is bit[0] for designs with CLINT.
      */
+    /* Traps run on a dedicated stack per hart, mscratch must point to it before the first trap */
+    interrupt_stack_init(hartid);
+
     mtvec_base = (uint32_t)&__mtvec_clint_vector_table;
     write_csr (mtvec, (mtvec_base | mode));
 
+    boot_profile_stamp(hartid, BOOT_PHASE_MTVEC);
+
     /* Control the flow of the harts for this application */
     if (hartid == boot_hart) {
 
+    /* calibrate the clocksource once, before any hart uses it for timeouts */
+    clocksource_init();
+
+    /* Make a default software handler for global interrupts */
+    for (i = 0; i < TOTAL_EXT_INTERRUPTS; i++ ){
+        aplic_handler_register(i, aplic_default_handler);
+    }
+
+#if BEU0_PRESENT
+    /* Set up APLIC "minor" software ISR functions, before any hart enables their sources */
+    aplic_handler_register(BUSERR0_INT_NUM, aplic_beu0_handler);
+    aplic_handler_register(BUSERR1_INT_NUM, aplic_beu1_handler);
+    aplic_handler_register(BUSERR2_INT_NUM, aplic_beu2_handler);
+    aplic_handler_register(BUSERR3_INT_NUM, aplic_beu3_handler);
+#endif
+
+    // domainCfg.globalInterrupt=1 to enable APLIC interrupts globally, in every cluster
+    aplic_cluster_domain_enable(ENABLE);
+    boot_profile_stamp(hartid, BOOT_PHASE_DOMAINCFG);
+
     /* flag to release other cores from spinning */
     harts_continue = 1;
 
@@ -99,9 +175,26 @@ int main(void) {
         /* Other cores wait till they are told to continue */
         while(!harts_continue);
 
+#if PARALLEL_INIT
+        /* Program our own IDC block and our share of the boot sources, while the other harts do the same */
+        aplic_hart_init(hartid, PRIO_THRESH_0);
+        boot_profile_stamp(hartid, BOOT_PHASE_IDC);
+
+#if BEU0_PRESENT
+        aplic_source_init(boot_sources, BOOT_SOURCES_COUNT, boot_hart, hartid, NUM_HARTS);
+        boot_profile_stamp(hartid, BOOT_PHASE_SOURCES);
+#endif
+
+        __atomic_fetch_add(&checkin_count, 1, __ATOMIC_RELEASE);
+#endif /* #if PARALLEL_INIT */
+
         /* All other harts write their own mie CSR to enable interrupts from APLIC */
         interrupt_external_enable();
 
+        /* Software interrupts are used to sync this hart's I-cache when the vector table is patched */
+        interrupt_software_enable();
+        vector_table_hart_online();
+
         /* enable interrupts globally for this hart */
         interrupt_global_enable();
 
@@ -114,28 +207,49 @@ int main(void) {
         //    do different work
         // ... etc ...
 
-        /* or just spin here */
-        while (1);
-    }
-
-    /* Make a default software handler for global interrupts */
-    for (i = 0; i < TOTAL_EXT_INTERRUPTS; i++ ){
-        aplic_minor_func[i] = aplic_default_handler;
+        /* or run deferred interrupt work, stolen from busy harts, and sleep when there is none */
+        executor_idle_loop();
     }
 
     /**************************************************/
     /*        Set up APLIC interrupts here            */
     /**************************************************/
-    // domainCfg.globalInterrupt=1 to enable APLIC interrupts globally
-    write_word(APLIC_DOMAINCFG_0_ADDR, APLIC_DOMAIN_CONFIG_GLOBAL_ENABLE);
-    
-    // per hart IDELIVERY set to 1 to enable
-    write_word(APLIC_IDELIVERY_ADDR(hartid), ENABLE);
+#if PARALLEL_INIT
+    // our own IDC only, the other harts program theirs
+    aplic_hart_init(hartid, PRIO_THRESH_0);	// 0=enable all interrupts.
+#else
+    // the boot hart programs the IDC of every hart
+    for (i = 0; i < NUM_HARTS; i++) {
+        aplic_hart_init(i, PRIO_THRESH_0);	// 0=enable all interrupts.
+    }
+#endif
+    boot_profile_stamp(hartid, BOOT_PHASE_IDC);
 
-    // Write the threshold value for this hart. 0 means enable all interrupts to be delivered
-    // A different example, if 0x4 is written here, then interrupts with priority 0-3 are allowed on this hart
-    // Lower the number, the higher the priority
-    write_word(APLIC_ITHRESHOLD_ADDR(hartid), PRIO_THRESH_0);	// 0=enable all interrupts.
+#if BEU0_PRESENT
+    /* Enable BEU for interrupt handling for certain events. We only enable these for testing for now,
+     * and this function will enable all available BEUs in the subsystem */
+    beu_aplic_config(BEU_DCACHE_SINGLE_BIT_ERROR | BEU_ICACHE_ITIM_SINGLE_BIT_ERROR);
+    boot_profile_stamp(hartid, BOOT_PHASE_BEU);
+
+    // Enable APLIC BEU interrupts and configure delivery method, priority, and whether it's a machine or supervisor interrupt
+#if PARALLEL_INIT
+    aplic_source_init(boot_sources, BOOT_SOURCES_COUNT, boot_hart, hartid, NUM_HARTS);
+#else
+    aplic_source_init(boot_sources, BOOT_SOURCES_COUNT, boot_hart, 0, 1);
+#endif
+    boot_profile_stamp(hartid, BOOT_PHASE_SOURCES);
+#endif /* #if BEU0_PRESENT */
+
+#if PARALLEL_INIT
+    /* Wait for every other hart to finish its share. They write checkin_count, so poll against a deadline */
+    deadline = clocksource_read() + clocksource_us_to_ticks(PARALLEL_INIT_TIMEOUT_US);
+    while ((checkin_count < (NUM_HARTS - 1)) && (clocksource_read() < deadline));
+
+    if (checkin_count < (NUM_HARTS - 1)) {
+        printf ("Only %d of %d harts finished parallel init!\n", checkin_count + 1, NUM_HARTS);
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+#endif
 
     /*************************************/
     /*            CSR Enables            */
@@ -143,27 +257,31 @@ int main(void) {
     interrupt_external_enable();      // machine external interrupt #11 enable in mie CSR
     interrupt_global_enable();        // write mstatus.mie = 1 to enable all machine interrupts globally
 
-#if BEU0_PRESENT
-    
-    /* Set up PLIC "minor" software ISR functions */
-    aplic_minor_func[BUSERR0_INT_NUM] = aplic_beu0_handler;
-    aplic_minor_func[BUSERR1_INT_NUM] = aplic_beu1_handler;
-    aplic_minor_func[BUSERR2_INT_NUM] = aplic_beu2_handler;
-    aplic_minor_func[BUSERR3_INT_NUM] = aplic_beu3_handler;
+    /* From here printf returns once the text is queued, the UART TX interrupt sends it */
+    if (console_init(boot_hart) != CONSOLE_OK) {
+        printf ("Console stays polled\n");
+    }
 
-    /* Enable BEU for interrupt handling for certain events. We only enable these for testing for now,
-     * and this function will enable all available BEUs in the subsystem */
-    beu_aplic_config(BEU_DCACHE_SINGLE_BIT_ERROR | BEU_ICACHE_ITIM_SINGLE_BIT_ERROR);
+    /* Priorities and thresholds generated by a profiling run, see aplic_tune_table.c. Sources
+     * enabled from here on take their tuned priority from aplic_tune_lookup() */
+    if (aplic_tune_apply(aplic_tune_table, aplic_tune_thresholds)) {
+        printf ("Could not apply the tuned APLIC priorities\n");
+    }
+
+#if APLIC_TUNE
+    aplic_tune_start();
+#endif
+
+    /*****************************************************/
+    /*  Include this hart in vector table I-cache syncs  */
+    /*****************************************************/
+    vector_table_hart_online();
+
+#if BEU0_PRESENT
 
     /* This is the error we will trigger via the BEU Accrued register to simulate APLIC error handling */
     simulate_beu_error = BEU_DCACHE_SINGLE_BIT_ERROR;
 
-       // Enable APLIC BEU interrupts and configure delivery method, priority, and whether it's a machine or supervisor interrupt
-    aplic_int_enable_disable (hartid, BUSERR0_INT_NUM, APLIC_SOURCECFG_MODE_RISE_EDGE, PRIO_THRESH_2, MACHINE_INTS);
-    aplic_int_enable_disable (hartid, BUSERR1_INT_NUM, APLIC_SOURCECFG_MODE_RISE_EDGE, PRIO_THRESH_2, MACHINE_INTS);
-    aplic_int_enable_disable (hartid, BUSERR2_INT_NUM, APLIC_SOURCECFG_MODE_RISE_EDGE, PRIO_THRESH_2, MACHINE_INTS);
-    aplic_int_enable_disable (hartid, BUSERR3_INT_NUM, APLIC_SOURCECFG_MODE_RISE_EDGE, PRIO_THRESH_2, MACHINE_INTS);
-    
     printf ("Testing APLIC interrupts for hart %d\n", hartid);
 
     /*********************************************************************************/
@@ -185,20 +303,20 @@ int main(void) {
             break;
     }
 
-    /* Spin here momentarily to allow the external isr to hit */
-    countdown = 0xfffff;
-    while ((external_isr_counter == 0) && (countdown > 0)) {
-        countdown--; asm ("nop"); 
-    }
+    /* Sleep here momentarily to allow the external isr to hit */
+    timer_wait_change_us(&external_isr_counter, 0, TIMER_WAIT_TIMEOUT_US);
 
-    /* Make sure we didn't count down all the way, which indicates we did not hit the external ISR */
-    if ((countdown == 0) && (external_isr_counter == 0)) {
+    /* Make sure we didn't time out, which indicates we did not hit the external ISR */
+    if (external_isr_counter == 0) {
         printf ("External handler did not get triggered! Check the setup.\n");
         return 0xEE;
     } else {
+        boot_profile_stamp(hartid, BOOT_PHASE_FIRST_IRQ);
+
         /* Describe what happened for this BEU error */
         printf ("Hart %d reporting BEU error: 0x%x\n", hartid, beu_accrued_value);		// BEU handler will update this value
         printf ("Total global interrupts triggered: %d\n", external_isr_counter);		// External handler will update this value
+        beu_log_report();
     }
     
 #endif /* #if BEU0_PRESENT */
@@ -212,16 +330,13 @@ int main(void) {
     for (i = 0; i < 5; i++) {
 
         software_isr_counter = 0;  // reset flag to check for spurious interrupts
-        countdown = 0xffff;
 
-        // trigger s/w interrupt here
-        write_word(CLINT_MSIP_ADDR_HART(hartid), 1);
+        // trigger s/w interrupt here, with a reason so it is counted even if an IPI from another hart is pending
+        ipi_send(hartid, IPI_SOFTWARE);
 
         // wait for software interrupt to fire
-        while ((software_isr_counter == 0) && (countdown--)){ asm ("nop"); }
-
         // if the s/w interrupt did not occur and we timeout, exit with fail code
-        if ((countdown == 0) && (software_isr_counter == 0)) {
+        if (timer_wait_change_us(&software_isr_counter, 0, TIMER_WAIT_TIMEOUT_US) == TIMER_WAIT_TIMEOUT) {
             printf ("Hart %d could not trigger software interrupt - check your config!\n", hartid);
             return 0x75;
         }
@@ -234,6 +349,35 @@ int main(void) {
     }
     printf("software interrupts - OK\n");
 
+    /*****************************************************/
+    /*    fan-out of one event to every hart's inbox     */
+    /*****************************************************/
+    {
+        uint32_t delivered[NUM_HARTS], waiting;
+        uint64_t deadline;
+
+        for (i = 0; i < NUM_HARTS; i++) {
+            fanout_subscribe(i, FANOUT_BIT(FANOUT_SRC_BEU) | FANOUT_BIT(FANOUT_SRC_CONFIG), NULL);
+            delivered[i] = fanout_inbox[i].delivered;
+        }
+
+        fanout_publish(FANOUT_SRC_CONFIG, 0, 0);
+
+        deadline = clocksource_read() + clocksource_us_to_ticks(TIMER_WAIT_TIMEOUT_US);
+        do {
+            for (waiting = 0, i = 0; i < NUM_HARTS; i++) {
+                waiting += (fanout_inbox[i].delivered == delivered[i]);
+            }
+        } while (waiting && (clocksource_read() < deadline));
+
+        if (waiting) {
+            printf ("%d harts did not get the fan-out event!\n", waiting);
+            fanout_report();
+            return 0xF0;
+        }
+        printf("fan-out - OK\n");
+    }
+
 
     /*************************************/
     /*    trigger timer interrupt        */
@@ -244,20 +388,12 @@ int main(void) {
     for (i = 0; i < 5; i++) {
 
         timer_isr_counter = 0;	// reset the flag to make sure we don't see spurious interrupts
-        countdown = 0xffff;
-
-        // figure out how fast the timer is ticking so we can set the number of ticks for timer to fire in the future
-        int time_a = read_word(CLINT_MTIME_BASE_ADDR);
-        asm ("nop"); asm ("nop"); asm ("nop"); asm ("nop"); asm ("nop");
-        int time_b = read_word(CLINT_MTIME_BASE_ADDR);
 
-        // write mtimecmp to allow the next timer interrupt to fire
-        write_dword(CLINT_MTIMECMP_ADDR_HART(hartid), (read_word(CLINT_MTIME_BASE_ADDR) + (time_b - time_a)*20 ));
+        // arm mtimecmp to allow the next timer interrupt to fire, using the calibrated clocksource
+        timer_arm(clocksource_read() + clocksource_us_to_ticks(TIMER_TEST_DELAY_US));
 
         // wait for timer interrupt to fire
-        while ((timer_isr_counter == 0) && (countdown--));
-
-        if ((countdown == 0) && (timer_isr_counter == 0)) {
+        if (timer_wait_change_us(&timer_isr_counter, 0, TIMER_WAIT_TIMEOUT_US) == TIMER_WAIT_TIMEOUT) {
             printf ("Hart %d could not trigger timer interrupt - check your config!\n", hartid);
             return 0x77;	// timeout, return with non zero error
         }
@@ -275,13 +411,13 @@ int main(void) {
     /*    trigger APLIC external interrupt via IFORCE    */
     /*****************************************************/
     // read topi first to make sure it's 0 before starting the test
-    uint32_t read_topi = read_word(APLIC_TOPI_ADDR(hartid));
+    uint32_t read_topi = read_word(aplic_hart_idc(hartid) + APLIC_IDC_TOPI);
     printf ("Testing IFORCE method for APLIC interrupt...\n");
 
     // Only trigger via IFORCE if TOPI currently reads as 0
     if (read_topi == 0) {
         // Create spurious external interrupt, #11
-        write_word(APLIC_IFORCE_ADDR(hartid), TRUE);	// only 0 or 1 here
+        write_word(aplic_hart_idc(hartid) + APLIC_IDC_IFORCE, TRUE);	// only 0 or 1 here
     } else {
         printf ("TOPI is reading 0x%lx, no interrupt triggered using IFORCE\n", read_topi);
         return 0xA1;
@@ -298,13 +434,14 @@ int main(void) {
         printf ("Testing SETIPNUM method for APLIC interrupt %d.\n", INTERRUPT_ID_FOR_SETIP_TEST);
 
         // install the handler
-        aplic_minor_func[INTERRUPT_ID_FOR_SETIP_TEST] = aplic_setip_by_num_handler;
+        aplic_handler_register(INTERRUPT_ID_FOR_SETIP_TEST, aplic_setip_by_num_handler);
 
         // enable this interrupt
-        aplic_int_enable_disable (hartid, INTERRUPT_ID_FOR_SETIP_TEST, APLIC_SOURCECFG_MODE_RISE_EDGE, PRIO_THRESH_2, MACHINE_INTS);
+        aplic_int_enable_disable (hartid, INTERRUPT_ID_FOR_SETIP_TEST, APLIC_SOURCECFG_MODE_RISE_EDGE,
+                                  aplic_tune_lookup(INTERRUPT_ID_FOR_SETIP_TEST, PRIO_THRESH_2), MACHINE_INTS);
 
         // trigger interrupt
-        write_word(APLIC_SETIPNUM_0_ADDR, INTERRUPT_ID_FOR_SETIP_TEST);
+        write_word(APLIC_INST_SETIPNUM_ADDR(aplic_source_base(INTERRUPT_ID_FOR_SETIP_TEST)), INTERRUPT_ID_FOR_SETIP_TEST);
 
         // make sure external interrupt is not pending
         if (read_csr(mip) & (1 << CLINT_MACHINE_EXTERNAL_INT_ID))  {
@@ -313,10 +450,122 @@ int main(void) {
     }
     printf("SETIPNUM - OK\n");
 
+    /*******************************************************/
+    /*    RAM shadow of the APLIC config matches the MMIO   */
+    /*******************************************************/
+    if (aplic_shadow_verify()) {
+        printf ("APLIC config shadow does not match the hardware!\n");
+        return 0xD0;
+    }
+    printf("APLIC shadow - OK\n");
+
+    /*****************************************************************/
+    /*    local interrupt fast lane against the APLIC claim path     */
+    /*****************************************************************/
+    // IRQ 16 and the SETIPNUM test source are done with, borrow them to time both paths
+    fast_irq_benchmark(INTERRUPT_ID_FOR_SET_MIP_TEST, INTERRUPT_ID_FOR_SETIP_TEST);
+
+#if JITTER_BENCHMARK
+    /*******************************************************/
+    /*    timer wakeup jitter under load on the other harts */
+    /*******************************************************/
+    {
+        const struct jitter_config jitter = { 100, 10000, JITTER_LOAD_APLIC | JITTER_LOAD_MEMORY | JITTER_LOAD_IPI };
+
+        if (jitter_run(&jitter) == JITTER_OK) {
+            jitter_report();
+        }
+    }
+#endif
+
+    /*************************************************/
+    /*    M-mode services through the ecall path     */
+    /*************************************************/
+    printf ("Testing ecall services...\n");
+    if (ecall_service(ECALL_SVC_HARTID, 0, 0, 0) != hartid) {
+        printf ("ecall returned the wrong hart ID!\n");
+        return 0xC0;
+    }
+
+    // a service number with nothing registered returns an error rather than trapping again
+    if (ecall_service(ECALL_NUM_SERVICES - 1, 0, 0, 0) != ECALL_ERR_NOSYS) {
+        printf ("ecall to an unused service did not fail!\n");
+        return 0xC1;
+    }
+    printf("ecall - OK\n");
+
+    /***********************************************************/
+    /*    misaligned load and store, emulated if they trap     */
+    /***********************************************************/
+    {
+        static uint8_t packed[16] __attribute__ ((aligned(8)));
+        volatile uint32_t *word = (volatile uint32_t *)&packed[1];
+        volatile int16_t *half = (volatile int16_t *)&packed[7];
+        uint32_t emulated = misaligned_emulated;
+
+        *word = 0x12345678;
+        *half = -2;
+
+        if ((*word != 0x12345678) || (*half != -2) || (packed[1] != 0x78) || (packed[4] != 0x12)) {
+            printf ("Misaligned access returned the wrong data!\n");
+            return 0xB0;
+        }
+
+        // two stores and two loads
+        emulated = misaligned_emulated - emulated;
+        printf ("Misaligned accesses %s (%d emulated)\n", emulated ? "emulated" : "handled by the core", emulated);
+
+#if MISALIGNED_TRAPS
+        if (emulated < 4) {
+            printf ("Misaligned accesses trap on this core but were not all emulated!\n");
+            return 0xB1;
+        }
+#endif
+    }
+    printf("misaligned access - OK\n");
+
+    /**********************************************************/
+    /*    defer work to the executor, idle harts steal it     */
+    /**********************************************************/
+    printf ("Testing deferred work on the executor...\n");
+    executor_test_done = 0;
+
+    for (i = 0; i < EXECUTOR_TEST_ITEMS; i++) {
+        if (executor_submit(executor_test_work, (void *)&executor_test_done) != EXECUTOR_OK) {
+            printf ("Executor deque full after %d items!\n", i);
+            while (executor_run_one(hartid));       // do not leave queued items behind
+            return 0xE0;
+        }
+    }
+
+    // run what the other harts do not steal, then wait for the items they are still running
+    while (executor_run_one(hartid));
+    deadline = clocksource_read() + clocksource_us_to_ticks(TIMER_WAIT_TIMEOUT_US);
+    while ((executor_test_done < EXECUTOR_TEST_ITEMS) && (clocksource_read() < deadline));
+
+    if (executor_test_done < EXECUTOR_TEST_ITEMS) {
+        printf ("Only %d of %d executor items completed!\n", executor_test_done, EXECUTOR_TEST_ITEMS);
+        // run or steal whatever is still queued, items already taken by a hart only touch the static counter
+        while (executor_run_one(hartid));
+        return 0xE1;
+    }
+    executor_report();
+    console_report();
+    printf("executor - OK\n");
+
     /************************************/
     /*    We are done, thank you        */
     /************************************/
     return_code = 0;    // if we get here we have passed. we return non-zero as we test things above
+    boot_profile_report();
+    interrupt_stack_report();
+    fanout_report();
+    pool_report(&beu_event_pool);
+    misaligned_report();
+#if APLIC_TUNE
+    aplic_tune_stop();
+    aplic_tune_emit(APLIC_TUNE_RATE_MONOTONIC);
+#endif
     printf ("Exiting test with code: %d\n", return_code);
 
     return (return_code); /* 0=pass */
@@ -0,0 +1,226 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#ifndef _APLIC_HPP_
+#define _APLIC_HPP_
+
+#include <stdint.h>
+
+extern "C" {
+#include "interrupts.h"
+#include "aplic_cluster.h"
+}
+
+/*****************************************************************************
+ * Header-only C++ (C++14 or later) APLIC driver.
+ *
+ * Same registers as the APLIC_* macros in interrupts.h, with typed volatile
+ * accesses and addresses computed at compile time. For a source or hart
+ * known at compile time every register address is a template argument, and
+ * every field value is a constant checked with static_assert, so e.g.
+ *
+ *     using beu0 = aplic::source<BUSERR0_INT_NUM, aplic::mode::rise_edge, 0, PRIO_THRESH_2>;
+ *     beu0::enable();
+ *
+ * compiles to three immediate stores, the same as the hand-written C in
+ * aplic_int_enable_disable() minus the SETIE read back. The constexpr
+ * helpers also accept runtime values, for the claim loop where the hart ID
+ * is only known at runtime.
+ *
+ * Parts with several APLICs follow aplic_cluster.h: a source is programmed
+ * in the APLIC local to its target hart, with the hart index inside its
+ * cluster, and enable() leaves it inactive in the other APLICs. The
+ * instance base addresses are BSP constants, so this adds one immediate
+ * store per other APLIC.
+ *****************************************************************************/
+
+namespace aplic {
+
+/* A memory mapped register at a fixed address */
+template <typename T, uintptr_t Addr>
+struct reg {
+    static_assert((Addr % sizeof(T)) == 0, "APLIC register is not naturally aligned");
+
+    static constexpr uintptr_t address = Addr;
+
+    static inline void write (T value) { *reinterpret_cast<volatile T *>(Addr) = value; }
+    static inline T read (void) { return *reinterpret_cast<volatile T *>(Addr); }
+};
+
+/* A memory mapped register at an address computed at runtime */
+static inline void write32 (uintptr_t addr, uint32_t value) { *reinterpret_cast<volatile uint32_t *>(addr) = value; }
+static inline uint32_t read32 (uintptr_t addr) { return *reinterpret_cast<volatile uint32_t *>(addr); }
+
+/* sourcecfg.SM source modes, 2 and 3 are reserved */
+enum class mode : uint32_t {
+    inactive    = APLIC_SOURCECFG_MODE_INACTIVE,
+    detached    = APLIC_SOURCECFG_MODE_DETATCHED,
+    rise_edge   = APLIC_SOURCECFG_MODE_RISE_EDGE,
+    fall_edge   = APLIC_SOURCECFG_MODE_FALL_EDGE,
+    high_level  = APLIC_SOURCECFG_MODE_HIGH_LEVEL,
+    low_level   = APLIC_SOURCECFG_MODE_LOW_LEVEL,
+};
+
+constexpr uint32_t MAX_SOURCES          = 1023;
+constexpr uint32_t MAX_HARTS            = 1 << 14;     // target.HartIndex is 14 bits
+constexpr uint32_t MAX_PRIORITY         = 0xFF;        // target.IPRIO is 8 bits, 0 is not a valid priority
+
+/*
+ * APLIC instances, see aplic_cluster.h
+ */
+constexpr uint32_t NUM_INSTANCES        = APLIC_NUM_INSTANCES;
+
+/* Same as aplic_instance_base[], usable at compile time */
+constexpr uintptr_t instance_base (uint32_t instance) {
+    return
+#if APLIC_NUM_INSTANCES > 3
+        (instance == 3) ? METAL_SIFIVE_APLICS_3_BASE_ADDRESS :
+#endif
+#if APLIC_NUM_INSTANCES > 2
+        (instance == 2) ? METAL_SIFIVE_APLICS_2_BASE_ADDRESS :
+#endif
+#if APLIC_NUM_INSTANCES > 1
+        (instance == 1) ? METAL_SIFIVE_APLICS_1_BASE_ADDRESS :
+#endif
+        METAL_SIFIVE_APLICS_0_BASE_ADDRESS;
+}
+
+constexpr uint32_t hart_instance (uint32_t hart)      { return APLIC_CLUSTER_OF_HART(hart); }
+constexpr uint32_t local_hart (uint32_t hart)         { return APLIC_LOCAL_HART(hart); }
+constexpr uintptr_t hart_base (uint32_t hart)         { return instance_base(hart_instance(hart)); }
+
+/*
+ * Addresses, in the APLIC at base, or in the APLIC local to a hart
+ */
+constexpr uintptr_t domaincfg_addr (uintptr_t base)               { return APLIC_INST_DOMAINCFG_ADDR(base); }
+constexpr uintptr_t sourcecfg_addr (uintptr_t base, uint32_t iid) { return APLIC_INST_SOURCECFG_ADDR(base, iid); }
+constexpr uintptr_t target_addr (uintptr_t base, uint32_t iid)    { return APLIC_INST_TARGET_ADDR(base, iid); }
+constexpr uintptr_t setip_addr (uintptr_t base, uint32_t iid)     { return APLIC_INST_SETIP_ADDR(base, iid); }
+constexpr uintptr_t setie_addr (uintptr_t base, uint32_t iid)     { return APLIC_INST_SETIE_ADDR(base, iid); }
+constexpr uintptr_t idc_addr (uint32_t hart)          { return APLIC_INST_IDC_ADDR(hart_base(hart), local_hart(hart)); }
+constexpr uintptr_t idelivery_addr (uint32_t hart)    { return idc_addr(hart) + APLIC_IDC_IDELIVERY; }
+constexpr uintptr_t iforce_addr (uint32_t hart)       { return idc_addr(hart) + APLIC_IDC_IFORCE; }
+constexpr uintptr_t ithreshold_addr (uint32_t hart)   { return idc_addr(hart) + APLIC_IDC_ITHRESHOLD; }
+constexpr uintptr_t topi_addr (uint32_t hart)         { return idc_addr(hart) + APLIC_IDC_TOPI; }
+constexpr uintptr_t claimi_addr (uint32_t hart)       { return idc_addr(hart) + APLIC_IDC_CLAIMI; }
+
+/* Bit position of a source in its SETIP/SETIE word. Matches check_setie_by_int_num() */
+constexpr uint32_t source_bit (uint32_t iid)          { return 1u << (iid % 32); }
+
+/*
+ * Field encoders
+ */
+constexpr uint32_t encode_sourcecfg (mode m)          { return static_cast<uint32_t>(m) | APLIC_SOURCECFG_NO_DELEGATION; }
+constexpr uint32_t encode_sourcecfg_delegated (uint32_t child) { return APLIC_SOURCECFG_DELEGATION_TO_S | (child & 0x3FF); }
+constexpr uint32_t encode_target (uint32_t hart, uint32_t priority) {
+    return (hart << APLIC_TARGET_HART_BIT_POSITION) | (priority & MAX_PRIORITY);
+}
+
+/* claimi and topi: ID is [25:16], priority is [7:0] */
+struct claim {
+    uint32_t raw;
+
+    constexpr uint32_t id (void) const       { return (raw >> 16) & 0x3FF; }
+    constexpr uint32_t priority (void) const { return raw & 0xFF; }
+    constexpr bool spurious (void) const     { return id() == 0; }
+};
+
+static_assert(setie_addr(APLIC_BASE_ADDR, 32) == setie_addr(APLIC_BASE_ADDR, 31) + 4, "source 32 is bit 0 of the second SETIE word");
+static_assert(instance_base(0) == APLIC_BASE_ADDR, "instance 0 is the APLIC of interrupts.h");
+static_assert(encode_target(1, PRIO_THRESH_2) == ((1 << 18) | 2), "target encoding");
+static_assert(claim{(21u << 16) | 2}.id() == 21, "claimi ID decoding");
+static_assert(claim{(21u << 16) | 2}.priority() == 2, "claimi priority decoding");
+
+/* Global domain of one APLIC instance. aplic_cluster_domain_enable() does all of them */
+template <uint32_t Instance = 0>
+struct domain {
+    static_assert(Instance < NUM_INSTANCES, "APLIC instance does not exist");
+
+    static constexpr uintptr_t base = instance_base(Instance);
+
+    using domaincfg = reg<uint32_t, domaincfg_addr(base)>;
+    using setipnum = reg<uint32_t, APLIC_INST_SETIPNUM_ADDR(base)>;
+    using clripnum = reg<uint32_t, APLIC_INST_CLRIPNUM_ADDR(base)>;
+    using setienum = reg<uint32_t, APLIC_INST_SETIENUM_ADDR(base)>;
+    using clrienum = reg<uint32_t, APLIC_INST_CLRIENUM_ADDR(base)>;
+
+    static inline void enable (void)  { domaincfg::write(APLIC_DOMAIN_CONFIG_GLOBAL_ENABLE); }
+    static inline void disable (void) { domaincfg::write(APLIC_DOMAIN_CONFIG_GLOBAL_DISABLE); }
+};
+
+/* One APLIC source, fully known at compile time */
+template <uint32_t IID, mode Mode, uint32_t Hart, uint32_t Priority>
+struct source {
+    static_assert((IID >= 1) && (IID <= MAX_SOURCES), "APLIC interrupt ID out of range");
+    static_assert(IID <= TOTAL_EXT_INTERRUPTS, "APLIC interrupt ID is above TOTAL_EXT_INTERRUPTS");
+    static_assert((Hart < NUM_HARTS) && (Hart < MAX_HARTS), "target hart does not exist");
+    static_assert((Priority >= 1) && (Priority <= MAX_PRIORITY), "APLIC priority must be 1 - 255");
+
+    static constexpr uint32_t id = IID;
+    static constexpr uint32_t instance = hart_instance(Hart);
+    static constexpr uintptr_t base = instance_base(instance);
+    static constexpr uint32_t sourcecfg_value = encode_sourcecfg(Mode);
+    static constexpr uint32_t target_value = encode_target(local_hart(Hart), Priority);
+
+    using sourcecfg = reg<uint32_t, sourcecfg_addr(base, IID)>;
+    using target = reg<uint32_t, target_addr(base, IID)>;
+    using setip = reg<uint32_t, setip_addr(base, IID)>;
+    using setie = reg<uint32_t, setie_addr(base, IID)>;
+    using local = domain<instance>;
+
+    static inline void enable (void) {
+#if APLIC_NUM_INSTANCES > 1
+        // only the APLIC of the target hart delivers it, as in aplic_int_enable_disable()
+        for (uint32_t i = 0; i < NUM_INSTANCES; i++) {
+            if (i != instance) {
+                write32(sourcecfg_addr(instance_base(i), IID), APLIC_SOURCECFG_MODE_INACTIVE);
+            }
+        }
+        aplic_source_instance[IID] = instance;
+#endif
+        sourcecfg::write(sourcecfg_value);
+        target::write(target_value);
+        local::setienum::write(IID);
+    }
+
+    static inline void disable (void)       { local::clrienum::write(IID); }
+    static inline void set_pending (void)   { local::setipnum::write(IID); }
+    static inline void clear_pending (void) { local::clripnum::write(IID); }
+    static inline bool enabled (void)       { return (setie::read() & source_bit(IID)) != 0; }
+    static inline bool pending (void)       { return (setip::read() & source_bit(IID)) != 0; }
+};
+
+/* Interrupt delivery control of one hart, known at compile time */
+template <uint32_t Hart>
+struct idc {
+    static_assert(Hart < NUM_HARTS, "hart does not exist");
+
+    using idelivery = reg<uint32_t, idelivery_addr(Hart)>;
+    using iforce = reg<uint32_t, iforce_addr(Hart)>;
+    using ithreshold = reg<uint32_t, ithreshold_addr(Hart)>;
+    using topi = reg<uint32_t, topi_addr(Hart)>;
+    using claimi = reg<uint32_t, claimi_addr(Hart)>;
+
+    template <uint32_t Threshold = PRIO_THRESH_0>
+    static inline void init (void) {
+        static_assert(Threshold <= MAX_PRIORITY, "APLIC threshold must be 0 - 255");
+        idelivery::write(ENABLE);
+        ithreshold::write(Threshold);
+    }
+
+    static inline struct claim claim (void) { return { claimi::read() }; }
+    static inline struct claim top (void)   { return { topi::read() }; }
+};
+
+/* Runtime hart, e.g. metal_cpu_get_current_hartid() in the claim loop */
+static inline struct claim claim (uint32_t hart) { return { read32(claimi_addr(hart)) }; }
+static inline struct claim top (uint32_t hart)   { return { read32(topi_addr(hart)) }; }
+
+static inline void idc_init (uint32_t hart, uint32_t threshold) {
+    write32(idelivery_addr(hart), ENABLE);
+    write32(ithreshold_addr(hart), threshold);
+}
+
+} /* namespace aplic */
+
+#endif /* _APLIC_HPP_ */
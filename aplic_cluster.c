@@ -0,0 +1,42 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#include "interrupts.h"
+#include "aplic_cluster.h"
+
+/* Every APLIC in the BSP, indexed by cluster */
+const uintptr_t aplic_instance_base[APLIC_NUM_INSTANCES] = {
+    METAL_SIFIVE_APLICS_0_BASE_ADDRESS,
+#if APLIC_NUM_INSTANCES > 1
+    METAL_SIFIVE_APLICS_1_BASE_ADDRESS,
+#endif
+#if APLIC_NUM_INSTANCES > 2
+    METAL_SIFIVE_APLICS_2_BASE_ADDRESS,
+#endif
+#if APLIC_NUM_INSTANCES > 3
+    METAL_SIFIVE_APLICS_3_BASE_ADDRESS,
+#endif
+};
+
+/* Source iid is bit (iid % 32) of word (iid / 32), so source 32 starts the second word */
+_Static_assert(APLIC_INST_SETIP_ADDR(0, 32) == APLIC_INST_SETIP_ADDR(0, 31) + 4, "SETIP word index must be iid / 32");
+_Static_assert(APLIC_INST_SETIE_ADDR(0, 32) == APLIC_INST_SETIE_ADDR(0, 31) + 4, "SETIE word index must be iid / 32");
+_Static_assert(APLIC_SETIE_0_ADDR(32) == APLIC_INST_SETIE_ADDR(APLIC_BASE_ADDR, 32), "legacy SETIE macro must match");
+
+/* Sources start out on APLIC 0 until they are routed */
+uint8_t aplic_source_instance[TOTAL_EXT_INTERRUPTS + 1];
+
+/* Write domaincfg of every APLIC instance */
+void aplic_cluster_domain_enable (uint32_t enable) {
+
+    uint32_t i;
+
+    for (i = 0; i < APLIC_NUM_INSTANCES; i++) {
+        write_word(APLIC_INST_DOMAINCFG_ADDR(aplic_instance_base[i]),
+                   (enable ? APLIC_DOMAIN_CONFIG_GLOBAL_ENABLE : APLIC_DOMAIN_CONFIG_GLOBAL_DISABLE));
+    }
+}
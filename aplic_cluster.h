@@ -0,0 +1,104 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#ifndef _APLIC_CLUSTER_H_
+#define _APLIC_CLUSTER_H_
+
+#include "interrupts.h"
+
+/*****************************************************************************
+ * Multiple APLIC instances, one per cluster of harts.
+ *
+ * Every APLIC described by the BSP (METAL_SIFIVE_APLICS_<n>_BASE_ADDRESS) is
+ * found at compile time. Harts are split into clusters of
+ * APLIC_HARTS_PER_CLUSTER consecutive hart IDs, and cluster n is served by
+ * APLIC n. Within an APLIC, IDC blocks and target.HartIndex use the index
+ * of the hart inside its cluster.
+ *
+ * Sources are assumed to be wired to every APLIC. aplic_int_enable_disable()
+ * programs a source in the APLIC of its target hart and leaves it inactive
+ * in the others, so the claim loop only ever reads the local APLIC and MMIO
+ * accesses from the interrupt path never cross the cluster interconnect.
+ *
+ * With a single APLIC every helper reduces to the _0_ macros in interrupts.h.
+ *****************************************************************************/
+
+#define APLIC_MAX_INSTANCES                     4
+
+#if defined(METAL_SIFIVE_APLICS_3_BASE_ADDRESS)
+#define APLIC_NUM_INSTANCES                     4
+#elif defined(METAL_SIFIVE_APLICS_2_BASE_ADDRESS)
+#define APLIC_NUM_INSTANCES                     3
+#elif defined(METAL_SIFIVE_APLICS_1_BASE_ADDRESS)
+#define APLIC_NUM_INSTANCES                     2
+#else
+#define APLIC_NUM_INSTANCES                     1
+#endif
+
+/* Override for parts where clusters are not an even split of the harts */
+#ifndef APLIC_HARTS_PER_CLUSTER
+#define APLIC_HARTS_PER_CLUSTER                 ((NUM_HARTS + APLIC_NUM_INSTANCES - 1) / APLIC_NUM_INSTANCES)
+#endif
+
+#define APLIC_CLUSTER_OF_HART(hartid)           ((hartid) / APLIC_HARTS_PER_CLUSTER)
+#define APLIC_LOCAL_HART(hartid)                ((hartid) % APLIC_HARTS_PER_CLUSTER)
+
+/* Register addresses relative to the base of any APLIC instance */
+#define APLIC_INST_DOMAINCFG_ADDR(base)         ((base) + METAL_SIFIVE_APLICS_DOMAINCFG_BASE)
+#define APLIC_INST_SOURCECFG_ADDR(base, iid)    ((base) + METAL_SIFIVE_APLICS_SOURCECFG_BASE + (0x4 * ((iid) - 1)))
+#define APLIC_INST_TARGET_ADDR(base, iid)       ((base) + METAL_SIFIVE_APLICS_TARGET_BASE + (0x4 * ((iid) - 1)))
+#define APLIC_INST_SETIP_ADDR(base, iid)        ((base) + METAL_SIFIVE_APLICS_SETIP_BASE + (0x4 * ((iid) >> 5)))     // bit (iid % 32)
+#define APLIC_INST_SETIE_ADDR(base, iid)        ((base) + METAL_SIFIVE_APLICS_SETIE_BASE + (0x4 * ((iid) >> 5)))
+#define APLIC_INST_SETIPNUM_ADDR(base)          ((base) + METAL_SIFIVE_APLICS_SETIPNUM_BASE)
+#define APLIC_INST_CLRIPNUM_ADDR(base)          ((base) + METAL_SIFIVE_APLICS_CLRIPNUM_BASE)
+#define APLIC_INST_SETIENUM_ADDR(base)          ((base) + METAL_SIFIVE_APLICS_SETIENUM_BASE)
+#define APLIC_INST_CLRIENUM_ADDR(base)          ((base) + METAL_SIFIVE_APLICS_CLRIENUM_BASE)
+#define APLIC_INST_IDC_ADDR(base, local_hart)   ((base) + HART_IDC_BASE + ((local_hart) * HART_IDC_OFFSET))
+
+/* Offsets within an IDC block */
+#define APLIC_IDC_IDELIVERY                     0x00
+#define APLIC_IDC_IFORCE                        0x04
+#define APLIC_IDC_ITHRESHOLD                    0x08
+#define APLIC_IDC_TOPI                          0x18
+#define APLIC_IDC_CLAIMI                        0x1C
+
+extern const uintptr_t aplic_instance_base[APLIC_NUM_INSTANCES];
+
+/* APLIC instance each source was last routed to, see aplic_int_enable_disable() */
+extern uint8_t aplic_source_instance[TOTAL_EXT_INTERRUPTS + 1];
+
+/* Base address of the APLIC local to a hart */
+static inline uintptr_t aplic_hart_base (uint32_t hartid) {
+#if APLIC_NUM_INSTANCES == 1
+    return APLIC_BASE_ADDR;
+#else
+    return aplic_instance_base[APLIC_CLUSTER_OF_HART(hartid)];
+#endif
+}
+
+/* IDC block of a hart, in its local APLIC */
+static inline uintptr_t aplic_hart_idc (uint32_t hartid) {
+#if APLIC_NUM_INSTANCES == 1
+    return APLIC_INST_IDC_ADDR(APLIC_BASE_ADDR, hartid);
+#else
+    return APLIC_INST_IDC_ADDR(aplic_hart_base(hartid), APLIC_LOCAL_HART(hartid));
+#endif
+}
+
+/* Base address of the APLIC a source is routed to */
+static inline uintptr_t aplic_source_base (uint32_t int_id) {
+#if APLIC_NUM_INSTANCES == 1
+    return APLIC_BASE_ADDR;
+#else
+    return aplic_instance_base[aplic_source_instance[int_id]];
+#endif
+}
+
+/* Prototypes */
+void aplic_cluster_domain_enable (uint32_t enable);
+
+#endif /* _APLIC_CLUSTER_H_ */
@@ -0,0 +1,37 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "aplic.hpp"
+
+/*****************************************************************************
+ * Builds aplic.hpp with the rest of the example, so the templates are
+ * instantiated and their addresses checked against the C macros on every
+ * build. aplic_hpp_setip_test_enable() is the three store sequence the
+ * header documents, disassemble it to check the codegen:
+ *
+ *     objdump -d aplic-example | grep -A8 '<aplic_hpp_setip_test_enable>:'
+ *****************************************************************************/
+
+using setip_test = aplic::source<INTERRUPT_ID_FOR_SETIP_TEST, aplic::mode::rise_edge, 0, PRIO_THRESH_2>;
+
+static_assert(setip_test::sourcecfg_value == (APLIC_SOURCECFG_MODE_RISE_EDGE | APLIC_SOURCECFG_NO_DELEGATION),
+              "sourcecfg does not match aplic_int_enable_disable()");
+// hart 0 is in cluster 0, served by the APLIC of interrupts.h
+static_assert(setip_test::sourcecfg::address == APLIC_SOURCECFG_0_ADDR(INTERRUPT_ID_FOR_SETIP_TEST),
+              "sourcecfg address does not match interrupts.h");
+static_assert(setip_test::target::address == APLIC_TARGET_0_0_ADDR(INTERRUPT_ID_FOR_SETIP_TEST),
+              "target address does not match interrupts.h");
+static_assert(aplic::claimi_addr(0) == APLIC_CLAIMI_ADDR(0), "claimi address does not match interrupts.h");
+
+extern "C" void aplic_hpp_setip_test_enable (void) {
+
+    setip_test::enable();
+}
+
+extern "C" uint32_t aplic_hpp_setip_test_enabled (void) {
+
+    return setip_test::enabled();
+}
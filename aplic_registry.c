@@ -0,0 +1,98 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#include "interrupts.h"
+#include "aplic_registry.h"
+
+/* Create array of function pointers for global minor (APLIC) interrupts */
+aplic_minor_handler_t aplic_minor_func[TOTAL_EXT_INTERRUPTS];
+
+/* Per-hart quiescent state counters, odd while in the external_handler dispatch loop */
+struct aplic_qs_counter aplic_qs[NUM_HARTS];
+
+/* Bit per interrupt ID, set if its handler uses floating point */
+volatile uint32_t aplic_minor_fp[(TOTAL_EXT_INTERRUPTS + 31) / 32];
+
+/* Wait until every other hart that was dispatching APLIC handlers has left external_handler */
+void aplic_handler_synchronize (void) {
+
+    uint32_t hartid = metal_cpu_get_current_hartid();
+    uint32_t snapshot[NUM_HARTS];
+    uint32_t i;
+
+    // handler stores are ordered before the counter reads, pairs with aplic_handler_dispatch_enter()
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    for (i = 0; i < NUM_HARTS; i++) {
+        snapshot[i] = aplic_qs[i].count;
+    }
+
+    for (i = 0; i < NUM_HARTS; i++) {
+
+        // even count means this hart was not dispatching, and will load the new handler next time
+        if ((i == hartid) || !(snapshot[i] & 1)) {
+            continue;
+        }
+
+        while (aplic_qs[i].count == snapshot[i]);
+    }
+
+    // nothing after this point can be reordered before the grace period ended
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/* Publish a handler and wait for a grace period. The FP flag is set before an FP handler
+ * can be seen, and only cleared once the old FP handler can no longer run */
+static aplic_minor_handler_t aplic_handler_publish (uint32_t int_id, aplic_minor_handler_t handler, uint32_t uses_fp) {
+
+    aplic_minor_handler_t old;
+    uint32_t bit = 1 << (int_id & 0x1F);
+
+    if (int_id >= TOTAL_EXT_INTERRUPTS) {
+        printf ("Interrupt ID: %d does not exist. Max interrupts is: %d\n", int_id, TOTAL_EXT_INTERRUPTS);
+        return NULL;
+    }
+
+    if (uses_fp) {
+        __atomic_fetch_or(&aplic_minor_fp[int_id >> 5], bit, __ATOMIC_RELAXED);
+    }
+
+    old = __atomic_exchange_n(&aplic_minor_func[int_id], handler, __ATOMIC_RELEASE);
+
+    aplic_handler_synchronize();
+
+    if (!uses_fp) {
+        __atomic_fetch_and(&aplic_minor_fp[int_id >> 5], ~bit, __ATOMIC_RELAXED);
+    }
+
+    return old;
+}
+
+/******************************************************************************
+ * Publish a minor handler for an APLIC interrupt ID and wait until no hart
+ * can still be running the handler it replaced.
+ *
+ * Returns the old handler, which may be freed or reused by the caller.
+ * Returns NULL if the interrupt ID is out of range.
+ *
+ *****************************************************************************/
+aplic_minor_handler_t aplic_handler_register (uint32_t int_id, aplic_minor_handler_t handler) {
+
+    return aplic_handler_publish(int_id, handler, FALSE);
+}
+
+/* Same as aplic_handler_register(), for a handler that uses floating point */
+aplic_minor_handler_t aplic_handler_register_fp (uint32_t int_id, aplic_minor_handler_t handler) {
+
+    return aplic_handler_publish(int_id, handler, TRUE);
+}
+
+/* Put back the default handler, and wait for the old one to finish on every hart */
+aplic_minor_handler_t aplic_handler_unregister (uint32_t int_id) {
+
+    return aplic_handler_register(int_id, aplic_default_handler);
+}
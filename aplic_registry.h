@@ -0,0 +1,80 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#ifndef _APLIC_REGISTRY_H_
+#define _APLIC_REGISTRY_H_
+
+#include "interrupts.h"
+
+/*****************************************************************************
+ * Runtime registration of APLIC minor handlers, safe while other harts are
+ * dispatching in external_handler.
+ *
+ * Handlers are published into aplic_minor_func with a release store and
+ * loaded by external_handler with an acquire load, so a new handler always
+ * sees the data its driver set up before registering it.
+ *
+ * Each hart keeps a counter that is odd while it is inside the dispatch loop
+ * of external_handler. aplic_handler_register() snapshots the counters after
+ * publishing, and waits only for harts that were inside the loop to leave
+ * it. Once it returns, no hart can still be running the old handler. The
+ * dispatch path never takes a lock.
+ *
+ * Do not register a handler from a minor handler: the calling hart is not
+ * waited for, so its own old handler may still be on the stack.
+ *
+ * Handlers that use floating point are registered with
+ * aplic_handler_register_fp(), so external_handler saves the interrupted
+ * FP state around them. See fp_context.h
+ *****************************************************************************/
+
+typedef void (*aplic_minor_handler_t)(void);
+
+/* Per-hart quiescent state counter, on its own cache line to avoid false sharing */
+struct aplic_qs_counter {
+    volatile uint32_t count;
+} __attribute__ ((aligned(CACHE_LINE_SIZE)));
+
+extern aplic_minor_handler_t aplic_minor_func[TOTAL_EXT_INTERRUPTS];
+extern struct aplic_qs_counter aplic_qs[NUM_HARTS];
+
+/* Bit per interrupt ID, set if its handler uses floating point */
+extern volatile uint32_t aplic_minor_fp[(TOTAL_EXT_INTERRUPTS + 31) / 32];
+
+/* Mark this hart as inside the dispatch loop (count is odd) */
+static inline void aplic_handler_dispatch_enter (uint32_t hartid) {
+
+    aplic_qs[hartid].count++;
+    asm volatile ("fence w, r" ::: "memory");    // counter store is visible before we load any handler
+}
+
+/* Mark this hart as quiescent (count is even) */
+static inline void aplic_handler_dispatch_exit (uint32_t hartid) {
+
+    asm volatile ("fence rw, w" ::: "memory");   // old handler is done before the counter store
+    aplic_qs[hartid].count++;
+}
+
+/* Load the handler for an interrupt ID, pairs with the release in aplic_handler_register() */
+static inline aplic_minor_handler_t aplic_handler_get (uint32_t int_id) {
+
+    return __atomic_load_n(&aplic_minor_func[int_id], __ATOMIC_ACQUIRE);
+}
+
+/* Check if the handler for an interrupt ID needs the FP context saved */
+static inline uint32_t aplic_handler_uses_fp (uint32_t int_id) {
+
+    return (aplic_minor_fp[int_id >> 5] >> (int_id & 0x1F)) & 1;
+}
+
+/* Prototypes */
+aplic_minor_handler_t aplic_handler_register (uint32_t int_id, aplic_minor_handler_t handler);
+aplic_minor_handler_t aplic_handler_register_fp (uint32_t int_id, aplic_minor_handler_t handler);
+aplic_minor_handler_t aplic_handler_unregister (uint32_t int_id);
+void aplic_handler_synchronize (void);
+
+#endif /* _APLIC_REGISTRY_H_ */
@@ -0,0 +1,108 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#include "interrupts.h"
+#include "aplic_shadow.h"
+#include "aplic_cluster.h"
+
+struct aplic_shadow aplic_shadow;
+
+/* Record a sourcecfg, target and SETIENUM write. Inactive and delegated sources read IE=0 in this domain */
+void aplic_shadow_set_source (uint32_t int_id, uint32_t source_mode, uint32_t delegated, uint32_t target_hart, uint32_t priority) {
+
+    uint32_t bit = 1 << (int_id & 0x1F);
+
+    aplic_shadow.source[int_id].target_hart = target_hart;
+    aplic_shadow.source[int_id].priority = priority;
+    aplic_shadow.source[int_id].sourcecfg = source_mode | (delegated ? APLIC_SHADOW_CFG_DELEGATED : 0);
+
+    // harts share bitmap words when they program sources in parallel
+    if (!delegated && (source_mode != APLIC_SOURCECFG_MODE_INACTIVE)) {
+        __atomic_fetch_or(&aplic_shadow.enabled[int_id >> 5], bit, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_and(&aplic_shadow.enabled[int_id >> 5], ~bit, __ATOMIC_RELAXED);
+    }
+}
+
+/* Record an IDC write */
+void aplic_shadow_set_hart (uint32_t hartid, uint32_t delivery, uint32_t threshold) {
+
+    aplic_shadow.hart[hartid].delivery = delivery;
+    aplic_shadow.hart[hartid].threshold = threshold;
+}
+
+/* Compare one source with the hardware. Returns the number of registers that differ */
+uint32_t aplic_shadow_check_source (uint32_t int_id) {
+
+    struct aplic_source_shadow *s = &aplic_shadow.source[int_id];
+    uintptr_t base = aplic_source_base(int_id);
+    uint32_t mode = s->sourcecfg & APLIC_SHADOW_CFG_MODE_MASK;
+    uint32_t sourcecfg, target, enabled, expected, mismatches = 0;
+
+    sourcecfg = read_word(APLIC_INST_SOURCECFG_ADDR(base, int_id));
+    expected = mode | ((s->sourcecfg & APLIC_SHADOW_CFG_DELEGATED) ? APLIC_SOURCECFG_DELEGATION_TO_S : APLIC_SOURCECFG_NO_DELEGATION);
+    if (sourcecfg != expected) {
+        printf ("APLIC shadow: interrupt %d sourcecfg 0x%x, shadow 0x%x\n", int_id, sourcecfg, expected);
+        mismatches++;
+    }
+
+    // target reads as zero for an inactive or delegated source
+    if (!(s->sourcecfg & APLIC_SHADOW_CFG_DELEGATED) && (mode != APLIC_SOURCECFG_MODE_INACTIVE)) {
+        target = read_word(APLIC_INST_TARGET_ADDR(base, int_id));
+        expected = (APLIC_LOCAL_HART(s->target_hart) << APLIC_TARGET_HART_BIT_POSITION) | s->priority;
+        if (target != expected) {
+            printf ("APLIC shadow: interrupt %d target 0x%x, shadow 0x%x\n", int_id, target, expected);
+            mismatches++;
+        }
+    }
+
+    enabled = (read_word(APLIC_INST_SETIE_ADDR(base, int_id)) >> (int_id % 32)) & 1;
+    expected = (aplic_shadow.enabled[int_id >> 5] >> (int_id & 0x1F)) & 1;
+    if (enabled != expected) {
+        printf ("APLIC shadow: interrupt %d enable %d, shadow %d\n", int_id, enabled, expected);
+        mismatches++;
+    }
+
+    return mismatches;
+}
+
+/* Compare the IDC of one hart with the hardware. Returns the number of registers that differ */
+uint32_t aplic_shadow_check_hart (uint32_t hartid) {
+
+    uintptr_t idc = aplic_hart_idc(hartid);
+    uint32_t delivery, threshold, mismatches = 0;
+
+    delivery = read_word(idc + APLIC_IDC_IDELIVERY);
+    if (delivery != aplic_shadow.hart[hartid].delivery) {
+        printf ("APLIC shadow: hart %d idelivery %d, shadow %d\n", hartid, delivery, aplic_shadow.hart[hartid].delivery);
+        mismatches++;
+    }
+
+    threshold = read_word(idc + APLIC_IDC_ITHRESHOLD);
+    if (threshold != aplic_shadow.hart[hartid].threshold) {
+        printf ("APLIC shadow: hart %d ithreshold %d, shadow %d\n", hartid, threshold, aplic_shadow.hart[hartid].threshold);
+        mismatches++;
+    }
+
+    return mismatches;
+}
+
+/* Compare the whole shadow with the hardware. Returns the number of registers that differ */
+uint32_t aplic_shadow_verify (void) {
+
+    uint32_t i, mismatches = 0;
+
+    for (i = 1; i <= TOTAL_EXT_INTERRUPTS; i++) {
+        mismatches += aplic_shadow_check_source(i);
+    }
+
+    for (i = 0; i < NUM_HARTS; i++) {
+        mismatches += aplic_shadow_check_hart(i);
+    }
+
+    return mismatches;
+}
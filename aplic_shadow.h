@@ -0,0 +1,110 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#ifndef _APLIC_SHADOW_H_
+#define _APLIC_SHADOW_H_
+
+#include "interrupts.h"
+
+/*****************************************************************************
+ * RAM shadow of the APLIC configuration.
+ *
+ * aplic_int_enable_disable() and aplic_hart_init() update the shadow next
+ * to every register write. Queries such as check_setie_by_int_num() are
+ * answered from it, so they hit the data cache instead of doing an uncached
+ * MMIO read. Pending bits change in hardware on their own and are not
+ * shadowed, check_setip_by_int_num() still reads SETIP.
+ *
+ * With APLIC_SHADOW_CHECK set in interrupts.h, every query also reads the
+ * hardware and prints any difference. aplic_shadow_verify() checks the
+ * whole shadow at once.
+ *
+ * Registers written outside the C driver (aplic.hpp, a debugger) are not
+ * seen by the shadow.
+ *****************************************************************************/
+
+#define APLIC_SHADOW_WORDS                      (((TOTAL_EXT_INTERRUPTS) >> 5) + 1)
+
+/* sourcecfg as written: SM in [2:0], and the delegation bit moved to [7] */
+#define APLIC_SHADOW_CFG_MODE_MASK              0x7
+#define APLIC_SHADOW_CFG_DELEGATED              0x80
+
+struct aplic_source_shadow {
+    uint16_t target_hart;                       // hart ID, not the index within the cluster
+    uint8_t priority;
+    uint8_t sourcecfg;
+};
+
+struct aplic_hart_shadow {
+    uint8_t delivery;
+    uint8_t threshold;
+};
+
+struct aplic_shadow {
+    uint32_t enabled[APLIC_SHADOW_WORDS];       // bit (int_id & 0x1F) of word (int_id >> 5)
+    struct aplic_source_shadow source[TOTAL_EXT_INTERRUPTS + 1];
+    struct aplic_hart_shadow hart[NUM_HARTS];
+};
+
+extern struct aplic_shadow aplic_shadow;
+
+/* Prototypes */
+void aplic_shadow_set_source (uint32_t int_id, uint32_t source_mode, uint32_t delegated, uint32_t target_hart, uint32_t priority);
+void aplic_shadow_set_hart (uint32_t hartid, uint32_t delivery, uint32_t threshold);
+uint32_t aplic_shadow_check_source (uint32_t int_id);
+uint32_t aplic_shadow_check_hart (uint32_t hartid);
+uint32_t aplic_shadow_verify (void);
+
+static inline uint32_t aplic_shadow_enabled (uint32_t int_id) {
+
+#if APLIC_SHADOW_CHECK
+    aplic_shadow_check_source(int_id);
+#endif
+    return (aplic_shadow.enabled[int_id >> 5] >> (int_id & 0x1F)) & 1;
+}
+
+static inline uint32_t aplic_shadow_target_hart (uint32_t int_id) {
+
+#if APLIC_SHADOW_CHECK
+    aplic_shadow_check_source(int_id);
+#endif
+    return aplic_shadow.source[int_id].target_hart;
+}
+
+static inline uint32_t aplic_shadow_priority (uint32_t int_id) {
+
+#if APLIC_SHADOW_CHECK
+    aplic_shadow_check_source(int_id);
+#endif
+    return aplic_shadow.source[int_id].priority;
+}
+
+static inline uint32_t aplic_shadow_source_mode (uint32_t int_id) {
+
+#if APLIC_SHADOW_CHECK
+    aplic_shadow_check_source(int_id);
+#endif
+    return aplic_shadow.source[int_id].sourcecfg & APLIC_SHADOW_CFG_MODE_MASK;
+}
+
+static inline uint32_t aplic_shadow_threshold (uint32_t hartid) {
+
+#if APLIC_SHADOW_CHECK
+    aplic_shadow_check_hart(hartid);
+#endif
+    return aplic_shadow.hart[hartid].threshold;
+}
+
+static inline uint32_t aplic_shadow_delivery (uint32_t hartid) {
+
+#if APLIC_SHADOW_CHECK
+    aplic_shadow_check_hart(hartid);
+#endif
+    return aplic_shadow.hart[hartid].delivery;
+}
+
+#endif /* _APLIC_SHADOW_H_ */
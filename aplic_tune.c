@@ -0,0 +1,234 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#include "interrupts.h"
+#include "aplic_tune.h"
+#include "aplic_shadow.h"
+#include "clocksource.h"
+
+struct aplic_tune_stats aplic_tune_stats[TOTAL_EXT_INTERRUPTS + 1];
+volatile uint32_t aplic_tune_active = FALSE;
+
+static uint64_t aplic_tune_start_cycles;
+static uint64_t aplic_tune_window;             // mcycles profiled
+
+/* Clear the statistics and start recording claims */
+void aplic_tune_start (void) {
+
+    uint32_t i;
+
+    aplic_tune_active = FALSE;
+    for (i = 0; i <= TOTAL_EXT_INTERRUPTS; i++) {
+        aplic_tune_stats[i].count = 0;
+        aplic_tune_stats[i].max_cycles = 0;
+        aplic_tune_stats[i].sum_cycles = 0;
+        aplic_tune_stats[i].min_gap = ~0ULL;
+    }
+
+    aplic_tune_start_cycles = clocksource_read_cycles();
+    aplic_tune_active = TRUE;
+}
+
+void aplic_tune_stop (void) {
+
+    aplic_tune_active = FALSE;
+    aplic_tune_window = clocksource_read_cycles() - aplic_tune_start_cycles;
+}
+
+/* Shortest time between arrivals, the whole window for a source seen once */
+static uint64_t aplic_tune_gap (uint32_t int_id) {
+
+    return (aplic_tune_stats[int_id].count > 1) ? aplic_tune_stats[int_id].min_gap : aplic_tune_window;
+}
+
+/* TRUE if source a should get a higher priority than source b */
+static uint32_t aplic_tune_before (uint32_t policy, uint32_t a, uint32_t b) {
+
+    if (policy == APLIC_TUNE_DEADLINE_MONOTONIC) {
+        return aplic_tune_gap(a) < aplic_tune_gap(b);
+    }
+
+    return aplic_tune_stats[a].count > aplic_tune_stats[b].count;
+}
+
+/* Priority of a source once the table is applied, its tuned one or the one it is programmed with */
+static uint32_t aplic_tune_priority (const struct aplic_tune_entry *table, uint32_t n, uint32_t int_id) {
+
+    uint32_t i;
+
+    for (i = 0; i < n; i++) {
+        if (table[i].int_id == int_id) {
+            return table[i].priority;
+        }
+    }
+
+    return aplic_shadow_priority(int_id);
+}
+
+/******************************************************************************
+ * Rank the sources seen since aplic_tune_start() and assign priorities and
+ * per-hart thresholds. Call after aplic_tune_stop().
+ *
+ * table gets one entry per source seen, most urgent first, and is not
+ * terminated. thresholds gets NUM_HARTS entries, each just past the least
+ * urgent priority on that hart, counting tuned sources and every other
+ * source enabled in the RAM shadow, so no source in use is masked.
+ *
+ * Returns the number of entries written to table.
+ *****************************************************************************/
+uint32_t aplic_tune_compute (uint32_t policy, struct aplic_tune_entry *table, uint32_t max_entries, uint8_t *thresholds) {
+
+    struct aplic_tune_entry entry;
+    uint32_t i, j, hart, priority, n = 0;
+
+    for (i = 1; (i <= TOTAL_EXT_INTERRUPTS) && (n < max_entries); i++) {
+        if (aplic_tune_stats[i].count) {
+            table[n++].int_id = i;
+        }
+    }
+
+    // insertion sort, there are only a handful of active sources
+    for (i = 1; i < n; i++) {
+        entry = table[i];
+        for (j = i; (j > 0) && aplic_tune_before(policy, entry.int_id, table[j - 1].int_id); j--) {
+            table[j] = table[j - 1];
+        }
+        table[j] = entry;
+    }
+
+    // spread the ranks over the priority levels, 1 is the highest
+    for (i = 0; i < n; i++) {
+        table[i].priority = 1 + ((i * APLIC_TUNE_PRIO_LEVELS) / n);
+    }
+
+    for (i = 0; i < NUM_HARTS; i++) {
+        thresholds[i] = PRIO_THRESH_0;
+    }
+
+    // tuned sources may be inactive by now, count them from the table
+    for (i = 0; i < n; i++) {
+        hart = aplic_shadow_target_hart(table[i].int_id);
+        if (table[i].priority >= thresholds[hart]) {
+            thresholds[hart] = table[i].priority + 1;
+        }
+    }
+
+    // sources that did not fire during the profile keep their priority, they must not be masked either
+    for (i = 1; i <= TOTAL_EXT_INTERRUPTS; i++) {
+        if (aplic_shadow_enabled(i)) {
+            hart = aplic_shadow_target_hart(i);
+            priority = aplic_tune_priority(table, n, i);
+            if (priority >= thresholds[hart]) {
+                thresholds[hart] = priority + 1;
+            }
+        }
+    }
+
+    // past the last level there is nothing to hold off
+    for (i = 0; i < NUM_HARTS; i++) {
+        if (thresholds[i] > APLIC_TUNE_PRIO_LEVELS) {
+            thresholds[i] = PRIO_THRESH_0;
+        }
+    }
+
+    return n;
+}
+
+/* Print the tuned configuration as C source for aplic_tune_table.c */
+void aplic_tune_emit (uint32_t policy) {
+
+    static struct aplic_tune_entry table[TOTAL_EXT_INTERRUPTS];
+    static uint8_t thresholds[NUM_HARTS];
+    uint64_t busy[NUM_HARTS] = { 0 };
+    struct aplic_tune_stats *s;
+    uint32_t i, n, id;
+
+    if (aplic_tune_window == 0) {
+        printf ("APLIC tune: nothing profiled, call aplic_tune_start() and aplic_tune_stop()\n");
+        return;
+    }
+
+    n = aplic_tune_compute(policy, table, TOTAL_EXT_INTERRUPTS, thresholds);
+
+    printf ("/* Generated by aplic_tune_emit(), %s over %d ms. Copy to aplic_tune_table.c */\n",
+            (policy == APLIC_TUNE_DEADLINE_MONOTONIC) ? "deadline-monotonic" : "rate-monotonic",
+            (uint32_t)(clocksource_cycles_to_ns(aplic_tune_window) / 1000000));
+
+    printf ("const struct aplic_tune_entry aplic_tune_table[] = {\n");
+    for (i = 0; i < n; i++) {
+        id = table[i].int_id;
+        s = &aplic_tune_stats[id];
+        busy[aplic_shadow_target_hart(id)] += s->sum_cycles;
+
+        printf ("    { %d, %d },\t/* hart %d, %d arrivals, min gap %d cycles, cost avg %d max %d cycles */\n",
+                id, table[i].priority, aplic_shadow_target_hart(id), s->count,
+                (uint32_t)aplic_tune_gap(id), (uint32_t)(s->sum_cycles / s->count), s->max_cycles);
+    }
+    printf ("    { 0, 0 }\n};\n\n");
+
+    printf ("const uint8_t aplic_tune_thresholds[NUM_HARTS] = {");
+    for (i = 0; i < NUM_HARTS; i++) {
+        printf ("%s %d", i ? "," : "", thresholds[i]);
+    }
+    printf (" };\n\n");
+
+    for (i = 0; i < NUM_HARTS; i++) {
+        if (busy[i]) {
+            printf ("/* hart %d spent %d.%02d%% of the window in handlers */\n", i,
+                    (uint32_t)((busy[i] * 100) / aplic_tune_window), (uint32_t)(((busy[i] * 10000) / aplic_tune_window) % 100));
+        }
+    }
+}
+
+/* Priority aplic_tune_table gives a source, for code that enables it after aplic_tune_apply() */
+uint32_t aplic_tune_lookup (uint32_t int_id, uint32_t default_priority) {
+
+    const struct aplic_tune_entry *e;
+
+    for (e = aplic_tune_table; e->int_id; e++) {
+        if (e->int_id == int_id) {
+            return e->priority;
+        }
+    }
+
+    return default_priority;
+}
+
+/******************************************************************************
+ * Program the priorities and thresholds of a generated table. Sources that
+ * are not enabled yet, or are delegated to S-mode, are skipped, so call it
+ * after every source has been set up.
+ *
+ * Returns 0, or the last error from aplic_int_enable_disable().
+ *****************************************************************************/
+uint32_t aplic_tune_apply (const struct aplic_tune_entry *table, const uint8_t *thresholds) {
+
+    const struct aplic_tune_entry *e;
+    uint32_t i, rc, return_code = 0;
+
+    for (e = table; e->int_id; e++) {
+
+        // delegated sources are never enabled in this domain
+        if (!aplic_shadow_enabled(e->int_id)) {
+            continue;
+        }
+
+        rc = aplic_int_enable_disable(aplic_shadow_target_hart(e->int_id), e->int_id, aplic_shadow_source_mode(e->int_id),
+                                      e->priority, MACHINE_INTS);
+        if (rc) {
+            return_code = rc;
+        }
+    }
+
+    for (i = 0; i < NUM_HARTS; i++) {
+        if (thresholds[i] != aplic_shadow_threshold(i)) {
+            aplic_hart_init(i, thresholds[i]);
+        }
+    }
+
+    return return_code;
+}
@@ -0,0 +1,92 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#ifndef _APLIC_TUNE_H_
+#define _APLIC_TUNE_H_
+
+#include "interrupts.h"
+
+/*****************************************************************************
+ * Profile-guided APLIC priorities and thresholds.
+ *
+ * With APLIC_TUNE set in interrupts.h, external_handler records every claim
+ * between aplic_tune_start() and aplic_tune_stop(): arrival count, shortest
+ * gap between arrivals and handler cost, all in mcycles.
+ * aplic_tune_emit() ranks the sources that were seen and prints the result
+ * as C source for aplic_tune_table.c:
+ *   APLIC_TUNE_RATE_MONOTONIC       most arrivals gets the highest priority
+ *   APLIC_TUNE_DEADLINE_MONOTONIC   shortest gap between arrivals does
+ * Ranks are spread over priorities 1 (highest) to APLIC_TUNE_PRIO_LEVELS.
+ *
+ * A hart's threshold is set just past the least urgent priority routed to
+ * it: the tuned priorities, and the priorities of every other source
+ * enabled in the RAM shadow, which keep what they were set up with. Every
+ * source in use stays deliverable, and anything enabled later with a lower
+ * priority is held off. A hart whose least urgent source is at
+ * APLIC_TUNE_PRIO_LEVELS keeps threshold 0.
+ *
+ * At boot, aplic_tune_apply() reprograms the priority of every source in
+ * the table. Target hart and source mode are kept, read from the RAM
+ * shadow. Code that enables a source later takes its priority from
+ * aplic_tune_lookup(). The table shipped here is empty, so apply does
+ * nothing until a generated one is pasted in.
+ *****************************************************************************/
+
+#define APLIC_TUNE_RATE_MONOTONIC               0
+#define APLIC_TUNE_DEADLINE_MONOTONIC           1
+
+#define APLIC_TUNE_PRIO_LEVELS                  PRIO_THRESH_7
+
+struct aplic_tune_stats {
+    uint32_t count;
+    uint32_t max_cycles;                        // handler cost
+    uint64_t sum_cycles;
+    uint64_t last_arrival;                      // mcycle at claim
+    uint64_t min_gap;                           // shortest time between two arrivals
+};
+
+/* One tuned source, the table ends with int_id 0 */
+struct aplic_tune_entry {
+    uint16_t int_id;
+    uint8_t priority;
+};
+
+extern struct aplic_tune_stats aplic_tune_stats[TOTAL_EXT_INTERRUPTS + 1];
+extern volatile uint32_t aplic_tune_active;
+
+/* Generated, see aplic_tune_table.c */
+extern const struct aplic_tune_entry aplic_tune_table[];
+extern const uint8_t aplic_tune_thresholds[NUM_HARTS];
+
+/* Prototypes */
+void aplic_tune_start (void);
+void aplic_tune_stop (void);
+uint32_t aplic_tune_compute (uint32_t policy, struct aplic_tune_entry *table, uint32_t max_entries, uint8_t *thresholds);
+void aplic_tune_emit (uint32_t policy);
+uint32_t aplic_tune_apply (const struct aplic_tune_entry *table, const uint8_t *thresholds);
+uint32_t aplic_tune_lookup (uint32_t int_id, uint32_t default_priority);
+
+/* Called by external_handler for every claimed source */
+static inline void aplic_tune_record (uint32_t int_id, uint64_t claimed, uint64_t returned) {
+
+    struct aplic_tune_stats *s = &aplic_tune_stats[int_id];
+    uint64_t cost = returned - claimed;
+
+    if (!aplic_tune_active) {
+        return;
+    }
+
+    if (s->count && ((claimed - s->last_arrival) < s->min_gap)) {
+        s->min_gap = claimed - s->last_arrival;
+    }
+    s->last_arrival = claimed;
+    s->max_cycles = (cost > s->max_cycles) ? cost : s->max_cycles;
+    s->sum_cycles += cost;
+    s->count++;
+}
+
+#endif /* _APLIC_TUNE_H_ */
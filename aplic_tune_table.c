@@ -0,0 +1,16 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#include "interrupts.h"
+#include "aplic_tune.h"
+
+/* Replace with the output of aplic_tune_emit(), built with APLIC_TUNE set */
+const struct aplic_tune_entry aplic_tune_table[] = {
+    { 0, 0 }
+};
+
+const uint8_t aplic_tune_thresholds[NUM_HARTS] = { 0 };
@@ -0,0 +1,84 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#include "interrupts.h"
+#include "beu_log.h"
+#include "clocksource.h"
+
+POOL_DEFINE(beu_event_pool, sizeof(struct beu_event), BEU_LOG_BLOCKS);
+
+volatile uint32_t beu_log_lost;
+
+/* Newest first. Taken as a whole with an exchange, so pushes see no ABA */
+static struct beu_event *volatile beu_log_head;
+
+/* Called from the BEU handlers */
+void beu_log_capture (uint32_t beu, uint32_t int_id, uint32_t cause, uint32_t value, uint32_t accrued) {
+
+    struct beu_event *event = pool_alloc(&beu_event_pool);
+
+    if (event == NULL) {
+        __atomic_fetch_add(&beu_log_lost, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    event->timestamp = clocksource_read();
+    event->beu = beu;
+    event->int_id = int_id;
+    event->hartid = metal_cpu_get_current_hartid();
+    event->cause = cause;
+    event->value = value;
+    event->accrued = accrued;
+
+    event->next = __atomic_load_n(&beu_log_head, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&beu_log_head, &event->next, event, TRUE, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/* Remove every logged event. Returns the list oldest first, NULL if empty */
+struct beu_event *beu_log_take (void) {
+
+    struct beu_event *list = __atomic_exchange_n(&beu_log_head, NULL, __ATOMIC_ACQUIRE);
+    struct beu_event *oldest = NULL, *next;
+
+    while (list) {
+        next = list->next;
+        list->next = oldest;
+        oldest = list;
+        list = next;
+    }
+
+    return oldest;
+}
+
+void beu_log_release (struct beu_event *list) {
+
+    struct beu_event *next;
+
+    while (list) {
+        next = list->next;
+        pool_free(&beu_event_pool, list);
+        list = next;
+    }
+}
+
+/* Print and release every logged event */
+void beu_log_report (void) {
+
+    struct beu_event *list = beu_log_take(), *event;
+
+    for (event = list; event; event = event->next) {
+        printf ("  BEU %d (interrupt %d) on hart %d at %d: cause %d, value 0x%x, accrued 0x%x\n",
+                event->beu, event->int_id, event->hartid, (uint32_t)event->timestamp,
+                event->cause, event->value, event->accrued);
+    }
+
+    if (beu_log_lost) {
+        printf ("  %d BEU events lost, %s exhausted\n", beu_log_lost, beu_event_pool.name);
+    }
+
+    beu_log_release(list);
+}
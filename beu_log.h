@@ -0,0 +1,47 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#ifndef _BEU_LOG_H_
+#define _BEU_LOG_H_
+
+#include "interrupts.h"
+#include "pool.h"
+
+/*****************************************************************************
+ * Log of bus errors, one record per BEU interrupt.
+ *
+ * The BEU handlers take a record from beu_event_pool and push it on a
+ * lock-free list, so a burst of errors on several harts is kept whole
+ * instead of overwriting beu_accrued_value. beu_log_take() removes every
+ * record at once, oldest first, and beu_log_release() gives them back to
+ * the pool. When the pool is exhausted the event is only counted in
+ * beu_log_lost.
+ *****************************************************************************/
+
+#define BEU_LOG_BLOCKS                          32
+
+struct beu_event {
+    struct beu_event *next;
+    uint64_t timestamp;                         // mtime when the handler ran
+    uint32_t beu;                               // BEU instance, 0 - 3
+    uint32_t int_id;
+    uint32_t hartid;                            // hart that took the interrupt
+    uint32_t cause;
+    uint32_t value;                             // physical address of the error
+    uint32_t accrued;
+};
+
+extern struct pool beu_event_pool;
+extern volatile uint32_t beu_log_lost;
+
+/* Prototypes */
+void beu_log_capture (uint32_t beu, uint32_t int_id, uint32_t cause, uint32_t value, uint32_t accrued);
+struct beu_event *beu_log_take (void);
+void beu_log_release (struct beu_event *list);
+void beu_log_report (void);
+
+#endif /* _BEU_LOG_H_ */
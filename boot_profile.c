@@ -0,0 +1,49 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#include "interrupts.h"
+#include "clocksource.h"
+#include "boot_profile.h"
+
+struct boot_timeline boot_timeline[NUM_HARTS];
+
+static const char *boot_phase_name[BOOT_PHASE_COUNT] = {
+    "metal init",
+    "main",
+    "mtvec",
+    "domaincfg",
+    "IDC",
+    "BEU config",
+    "source enable",
+    "first interrupt",
+};
+
+/* Print the mcycle stamp of every phase, and the time since the previous phase, for every hart */
+void boot_profile_report (void) {
+
+    uint64_t prev, stamp;
+    uint32_t hart, phase;
+
+    printf ("Boot timeline (%s init):\n", PARALLEL_INIT ? "parallel" : "serial");
+
+    for (hart = 0; hart < NUM_HARTS; hart++) {
+
+        prev = 0;
+        for (phase = 0; phase < BOOT_PHASE_COUNT; phase++) {
+
+            stamp = boot_timeline[hart].stamp[phase];
+            if (stamp == 0) {
+                continue;
+            }
+
+            printf ("  hart %d %-16s mcycle %10lu  +%8lu cycles  +%8lu ns\n", hart, boot_phase_name[phase],
+                    (unsigned long)stamp, (unsigned long)(stamp - prev),
+                    (unsigned long)clocksource_cycles_to_ns(stamp - prev));
+            prev = stamp;
+        }
+    }
+}
@@ -0,0 +1,48 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#ifndef _BOOT_PROFILE_H_
+#define _BOOT_PROFILE_H_
+
+#include "interrupts.h"
+#include "clocksource.h"
+
+/*****************************************************************************
+ * Boot timeline. Each hart stamps mcycle as it finishes an init phase, and
+ * the boot hart prints every hart's timeline at the end of main(). mcycle
+ * counts from reset, so the first stamp includes the crt0 time.
+ *
+ * Set PARALLEL_INIT in interrupts.h to compare the two init modes.
+ *****************************************************************************/
+
+/* Init phases, in the order they complete */
+#define BOOT_PHASE_METAL_INIT                   0       // metal_init_run / metal_secondary_init_run
+#define BOOT_PHASE_MAIN                         1       // crt0 done, main() entered
+#define BOOT_PHASE_MTVEC                        2       // vector table in mtvec
+#define BOOT_PHASE_DOMAINCFG                    3       // APLIC enabled globally
+#define BOOT_PHASE_IDC                          4       // interrupt delivery control programmed
+#define BOOT_PHASE_BEU                          5       // bus error units configured
+#define BOOT_PHASE_SOURCES                      6       // APLIC sources enabled
+#define BOOT_PHASE_FIRST_IRQ                    7       // first APLIC interrupt handled
+#define BOOT_PHASE_COUNT                        8
+
+/* One row per hart, on its own cache line(s) */
+struct boot_timeline {
+    uint64_t stamp[BOOT_PHASE_COUNT];           // mcycle, 0 if the phase was not reached on this hart
+} __attribute__ ((aligned(CACHE_LINE_SIZE)));
+
+extern struct boot_timeline boot_timeline[NUM_HARTS];
+
+static inline void boot_profile_stamp (uint32_t hartid, uint32_t phase) {
+
+    boot_timeline[hartid].stamp[phase] = clocksource_read_cycles();
+}
+
+/* Prototypes */
+void boot_profile_report (void);
+
+#endif /* _BOOT_PROFILE_H_ */
@@ -0,0 +1,138 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+#include <metal/timer.h>
+
+#include "interrupts.h"
+#include "clocksource.h"
+
+/* Written once by clocksource_init() on the boot hart, read only afterwards */
+struct clocksource clocksource;
+
+/* Read the 64-bit mtime without tearing */
+uint64_t clocksource_read (void) {
+
+#if __riscv_xlen == 32
+    uint32_t hi, lo;
+
+    // re-read if the upper half changed while we read the lower half
+    do {
+        hi = read_word(CLINT_MTIME_BASE_ADDR + 4);
+        lo = read_word(CLINT_MTIME_BASE_ADDR);
+    } while (hi != read_word(CLINT_MTIME_BASE_ADDR + 4));
+
+    return ((uint64_t)hi << 32) | lo;
+#else
+    return read_dword(CLINT_MTIME_BASE_ADDR);
+#endif
+}
+
+/* Read the 64-bit mcycle CSR without tearing */
+uint64_t clocksource_read_cycles (void) {
+
+#if __riscv_xlen == 32
+    uint32_t hi, lo;
+
+    do {
+        hi = read_csr(mcycleh);
+        lo = read_csr(mcycle);
+    } while (hi != read_csr(mcycleh));
+
+    return ((uint64_t)hi << 32) | lo;
+#else
+    return read_csr(mcycle);
+#endif
+}
+
+/* Compute mult/shift to convert from from_freq to to_freq. Pick the largest shift
+ * (at most 32) whose mult still fits in 32 bits, for the best precision */
+static void clocksource_calc_conv (struct clocksource_conv *conv, uint64_t from_freq, uint64_t to_freq) {
+
+    uint64_t mult = 0;
+    uint32_t shift;
+
+    if (from_freq == 0) {
+        conv->mult = 0;
+        conv->shift = 0;
+        return;
+    }
+
+    for (shift = 32; shift > 0; shift--) {
+        mult = ((to_freq << shift) + (from_freq / 2)) / from_freq;
+        if (mult <= 0xFFFFFFFFULL) {
+            break;
+        }
+    }
+
+    conv->mult = (uint32_t)mult;
+    conv->shift = shift;
+}
+
+/* (value * mult) >> shift, done in two 32x32 halves so it doesn't overflow 64 bits */
+uint64_t clocksource_convert (uint64_t value, const struct clocksource_conv *conv) {
+
+    uint64_t lo = ((uint64_t)(uint32_t)value * conv->mult) >> conv->shift;
+    uint64_t hi = ((value >> 32) * conv->mult) << (32 - conv->shift);
+
+    return hi + lo;
+}
+
+uint64_t clocksource_ticks_to_ns (uint64_t ticks) {
+
+    return clocksource_convert(ticks, &clocksource.ticks_to_ns);
+}
+
+uint64_t clocksource_cycles_to_ns (uint64_t cycles) {
+
+    return clocksource_convert(cycles, &clocksource.cycles_to_ns);
+}
+
+uint64_t clocksource_us_to_ticks (uint64_t us) {
+
+    return clocksource_convert(us, &clocksource.us_to_ticks);
+}
+
+/* Nanoseconds since clocksource_init(). mtime never goes backwards, so neither does this */
+uint64_t clocksource_monotonic_ns (void) {
+
+    return clocksource_ticks_to_ns(clocksource_read() - clocksource.epoch);
+}
+
+/******************************************************************************
+ * Find the mtime and mcycle frequencies and cache the conversion factors.
+ * Call once on the boot hart before other harts use the clocksource.
+ *****************************************************************************/
+void clocksource_init (void) {
+
+    unsigned long long timebase;
+    uint64_t start, t0, c0, c1;
+
+    if (metal_timer_get_timebase_frequency(metal_cpu_get_current_hartid(), &timebase) || (timebase == 0)) {
+        timebase = RTC_FREQ;
+    }
+    clocksource.mtime_freq = timebase;
+
+    // start the measurement right on an mtime edge
+    start = clocksource_read();
+    while ((t0 = clocksource_read()) == start);
+    c0 = clocksource_read_cycles();
+
+    // and end it right on an edge too
+    while (clocksource_read() < (t0 + CLOCKSOURCE_CALIBRATION_TICKS));
+    c1 = clocksource_read_cycles();
+
+    clocksource.cycle_freq = ((c1 - c0) * clocksource.mtime_freq) / CLOCKSOURCE_CALIBRATION_TICKS;
+
+    clocksource_calc_conv(&clocksource.ticks_to_ns, clocksource.mtime_freq, NSEC_PER_SEC);
+    clocksource_calc_conv(&clocksource.cycles_to_ns, clocksource.cycle_freq, NSEC_PER_SEC);
+    clocksource_calc_conv(&clocksource.us_to_ticks, USEC_PER_SEC, clocksource.mtime_freq);
+
+    clocksource.epoch = clocksource_read();
+
+#if DEBUG_PRINT
+    printf ("Clocksource: mtime %lu Hz, mcycle %lu Hz\n", (unsigned long)clocksource.mtime_freq, (unsigned long)clocksource.cycle_freq);
+#endif
+}
@@ -0,0 +1,62 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#ifndef _CLOCKSOURCE_H_
+#define _CLOCKSOURCE_H_
+
+#include "interrupts.h"
+
+/*****************************************************************************
+ * mtime clocksource.
+ *
+ * clocksource_read() returns the full 64-bit mtime, also on RV32 where the
+ * two halves are read with a hi/lo/hi sequence so a carry between the
+ * reads is never seen as a jump backwards or forwards.
+ *
+ * clocksource_init() runs once on the boot hart. It takes the mtime
+ * frequency from the BSP timebase (RTC_FREQ if the BSP has none), measures
+ * the mcycle frequency against it, and caches mult/shift pairs so that
+ * conversions are a multiply and a shift, never a division:
+ *      ns = (ticks * mult) >> shift
+ *****************************************************************************/
+
+/* mtime ticks measured against mcycle at boot. Both ends are aligned to an
+ * mtime edge, so a short window is enough */
+#define CLOCKSOURCE_CALIBRATION_TICKS           16
+
+#define NSEC_PER_SEC                            1000000000ULL
+#define NSEC_PER_USEC                           1000ULL
+#define USEC_PER_SEC                            1000000ULL
+
+/* Multiply by a 32-bit factor and shift, from the cached conversion pair */
+struct clocksource_conv {
+    uint32_t mult;
+    uint32_t shift;
+};
+
+struct clocksource {
+    uint64_t mtime_freq;                // Hz
+    uint64_t cycle_freq;                // Hz, measured at boot
+    uint64_t epoch;                     // mtime at clocksource_init()
+    struct clocksource_conv ticks_to_ns;
+    struct clocksource_conv cycles_to_ns;
+    struct clocksource_conv us_to_ticks;
+};
+
+extern struct clocksource clocksource;
+
+/* Prototypes */
+void clocksource_init (void);
+uint64_t clocksource_read (void);
+uint64_t clocksource_read_cycles (void);
+uint64_t clocksource_convert (uint64_t value, const struct clocksource_conv *conv);
+uint64_t clocksource_ticks_to_ns (uint64_t ticks);
+uint64_t clocksource_cycles_to_ns (uint64_t cycles);
+uint64_t clocksource_us_to_ticks (uint64_t us);
+uint64_t clocksource_monotonic_ns (void);
+
+#endif /* _CLOCKSOURCE_H_ */
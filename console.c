@@ -0,0 +1,208 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <metal/machine.h>
+
+#include "interrupts.h"
+#include "console.h"
+#include "aplic_registry.h"
+
+struct console console;
+
+#if UART0_PRESENT
+
+#define uart_reg(addr)      (*(volatile uint32_t *)(addr))
+
+static uintptr_t console_lock (void) {
+
+    uintptr_t mstatus;
+
+    __asm__ volatile ("csrrc %0, mstatus, %1" : "=r"(mstatus) : "r"(METAL_MIE_INTERRUPT));
+    while (__atomic_exchange_n(&console.lock, 1, __ATOMIC_ACQUIRE));
+
+    return mstatus;
+}
+
+static void console_unlock (uintptr_t mstatus) {
+
+    __atomic_store_n(&console.lock, 0, __ATOMIC_RELEASE);
+    __asm__ volatile ("csrs mstatus, %0" :: "r"(mstatus & METAL_MIE_INTERRUPT));
+}
+
+/* Move the ring into the TX FIFO until one of them is full or empty. Lock held */
+static void console_fill_fifo (void) {
+
+    while ((console.tail != console.head) && !(uart_reg(UART0_TXDATA_ADDR) & UART0_TXDATA_FULL)) {
+        uart_reg(UART0_TXDATA_ADDR) = console.buf[console.tail & CONSOLE_BUF_MASK];
+        console.tail++;
+    }
+}
+
+/* Lock held */
+static void console_drain (void) {
+
+    while (console.tail != console.head) {
+        console_fill_fifo();
+    }
+}
+
+static void console_putc_sync (char c) {
+
+    while (uart_reg(UART0_TXDATA_ADDR) & UART0_TXDATA_FULL);
+    uart_reg(UART0_TXDATA_ADDR) = c;
+}
+
+/* Lock held. Waits for room by transmitting from this hart */
+static void console_putc_async (char c) {
+
+    if ((console.head - console.tail) == CONSOLE_BUF_SIZE) {
+        console.full_waits++;
+        while ((console.head - console.tail) == CONSOLE_BUF_SIZE) {
+            console_fill_fifo();
+        }
+    }
+
+    console.buf[console.head & CONSOLE_BUF_MASK] = c;
+    console.head++;
+}
+
+/* Backend of printf and friends, replaces the one in freedom-metal */
+ssize_t _write (int file, const void *ptr, size_t len) {
+
+    const char *p = (const char *)ptr;
+    uintptr_t mstatus;
+    size_t i;
+
+    if (!console.ready || console.sync) {
+        for (i = 0; i < len; i++) {
+            if (p[i] == '\n') {
+                console_putc_sync('\r');
+            }
+            console_putc_sync(p[i]);
+        }
+        return len;
+    }
+
+    mstatus = console_lock();
+
+    for (i = 0; i < len; i++) {
+        if (p[i] == '\n') {
+            console_putc_async('\r');
+        }
+        console_putc_async(p[i]);
+    }
+
+    // start transmitting now, the TX watermark interrupt sends the rest
+    console_fill_fifo();
+    if (console.tail != console.head) {
+        uart_reg(UART0_IE_ADDR) |= UART0_IE_TXWM;
+    }
+
+    console_unlock(mstatus);
+
+    return len;
+}
+
+/* Send what is left in the ring before exit() stops the hart */
+static void console_exit (void) {
+
+    // console_panic() already sent the ring, and this hart may have faulted holding the lock
+    if (console.sync) {
+        return;
+    }
+
+    console_set_sync(TRUE);
+}
+
+#endif /* #if UART0_PRESENT */
+
+/******************************************************************************
+ * Switch the console to interrupt driven output. The UART TX watermark
+ * interrupt is routed to target_hart.
+ *
+ * Returns CONSOLE_ERR_NO_UART if the design has no UART0, or the error from
+ * aplic_int_enable_disable(). Output stays polled on error.
+ *****************************************************************************/
+uint32_t console_init (uint32_t target_hart) {
+
+#if UART0_PRESENT
+    uint32_t txctrl, rc;
+
+    // no TX interrupt until there is something in the ring
+    uart_reg(UART0_IE_ADDR) &= ~UART0_IE_TXWM;
+
+    txctrl = uart_reg(UART0_TXCTRL_ADDR) & ~UART0_TXCTRL_TXCNT_MASK;
+    uart_reg(UART0_TXCTRL_ADDR) = txctrl | (CONSOLE_TX_WATERMARK << UART0_TXCTRL_TXCNT_SHIFT);
+
+    aplic_handler_register(CONSOLE_INT_NUM, console_tx_handler);
+
+    // txwm is a level, low priority, as nothing waits for the console
+    rc = aplic_int_enable_disable(target_hart, CONSOLE_INT_NUM, APLIC_SOURCECFG_MODE_HIGH_LEVEL, PRIO_THRESH_7, MACHINE_INTS);
+    if (rc) {
+        return rc;
+    }
+
+    atexit(console_exit);
+    __atomic_store_n(&console.ready, TRUE, __ATOMIC_RELEASE);
+
+    return CONSOLE_OK;
+#else
+    return CONSOLE_ERR_NO_UART;
+#endif
+}
+
+/* APLIC minor handler for the UART TX watermark */
+void console_tx_handler (void) {
+
+#if UART0_PRESENT
+    uintptr_t mstatus = console_lock();
+
+    console_fill_fifo();
+
+    // nothing left to send, stop the level interrupt
+    if (console.tail == console.head) {
+        uart_reg(UART0_IE_ADDR) &= ~UART0_IE_TXWM;
+    }
+    console.tx_interrupts++;
+
+    console_unlock(mstatus);
+#endif
+}
+
+/* Polled output from now on, e.g. before exit() so nothing is left in the ring */
+void console_set_sync (uint32_t sync) {
+
+#if UART0_PRESENT
+    uintptr_t mstatus = console_lock();
+
+    if (sync) {
+        console_drain();
+        uart_reg(UART0_IE_ADDR) &= ~UART0_IE_TXWM;
+    }
+    console.sync = sync;
+
+    console_unlock(mstatus);
+#endif
+}
+
+/* Polled output for panic paths. Takes no lock, the ring is sent as is */
+void console_panic (void) {
+
+#if UART0_PRESENT
+    console.sync = TRUE;
+    uart_reg(UART0_IE_ADDR) &= ~UART0_IE_TXWM;
+
+    while (console.tail != console.head) {
+        console_putc_sync(console.buf[console.tail & CONSOLE_BUF_MASK]);
+        console.tail++;
+    }
+#endif
+}
+
+void console_report (void) {
+
+    printf ("Console: %d TX interrupts, %d writes waited for a full ring\n", console.tx_interrupts, console.full_waits);
+}
@@ -0,0 +1,75 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#ifndef _CONSOLE_H_
+#define _CONSOLE_H_
+
+#include "interrupts.h"
+
+/*****************************************************************************
+ * Interrupt driven console on UART0.
+ *
+ * printf ends up in _write(), which is overridden here to copy the text
+ * into a ring buffer and return. The UART TX watermark interrupt, routed
+ * through the APLIC like any other source, moves the ring into the TX FIFO.
+ * A writer only transmits itself when the ring is full.
+ *
+ * Writes are polled, as with the metal TTY, until console_init() has run,
+ * after console_set_sync(TRUE), and after console_panic(). The panic path
+ * takes no lock, so it works from an exception taken with the lock held.
+ *
+ * All harts share the ring under a spinlock taken with interrupts disabled,
+ * so a handler printing on the hart that holds it can not deadlock.
+ *****************************************************************************/
+
+#define CONSOLE_BUF_SIZE                        1024        // must be a power of 2
+#define CONSOLE_BUF_MASK                        (CONSOLE_BUF_SIZE - 1)
+
+/* refill the 8 entry TX FIFO when fewer than this many bytes are left in it */
+#define CONSOLE_TX_WATERMARK                    4
+
+/* SiFive UART0 registers */
+#if UART0_PRESENT
+#define UART0_BASE_ADDR                         METAL_SIFIVE_UART0_0_BASE_ADDRESS
+#define UART0_TXDATA_ADDR                       (UART0_BASE_ADDR + METAL_SIFIVE_UART0_TXDATA)
+#define UART0_TXCTRL_ADDR                       (UART0_BASE_ADDR + METAL_SIFIVE_UART0_TXCTRL)
+#define UART0_IE_ADDR                           (UART0_BASE_ADDR + METAL_SIFIVE_UART0_IE)
+#define CONSOLE_INT_NUM                         UART0_INT_NUM
+#else
+#define CONSOLE_INT_NUM                         0xFFFFFFFF  // never claimed
+#endif
+
+#define UART0_TXDATA_FULL                       (1UL << 31)
+#define UART0_TXCTRL_TXCNT_SHIFT                16
+#define UART0_TXCTRL_TXCNT_MASK                 (0x7 << UART0_TXCTRL_TXCNT_SHIFT)
+#define UART0_IE_TXWM                           (1 << 0)
+
+/* Return codes */
+#define CONSOLE_OK                              0
+#define CONSOLE_ERR_NO_UART                     0x1
+
+struct console {
+    char buf[CONSOLE_BUF_SIZE];
+    uint32_t head;                              // next byte written by _write()
+    uint32_t tail;                              // next byte to move to the TX FIFO
+    volatile uint32_t lock;
+    volatile uint32_t ready;                    // interrupt driven, set by console_init()
+    volatile uint32_t sync;                     // polled, set by console_set_sync() and console_panic()
+    uint32_t tx_interrupts;
+    uint32_t full_waits;                        // writes that had to transmit because the ring was full
+} __attribute__ ((aligned(CACHE_LINE_SIZE)));
+
+extern struct console console;
+
+/* Prototypes */
+uint32_t console_init (uint32_t target_hart);
+void console_tx_handler (void);
+void console_set_sync (uint32_t sync);
+void console_panic (void);
+void console_report (void);
+
+#endif /* _CONSOLE_H_ */
@@ -0,0 +1,94 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#include "interrupts.h"
+#include "exception.h"
+#include "timer.h"
+#include "ipi.h"
+
+static uintptr_t ecall_hartid (uintptr_t a0, uintptr_t a1, uintptr_t a2) {
+
+    return read_csr(mhartid);
+}
+
+static uintptr_t ecall_timer_arm (uintptr_t a0, uintptr_t a1, uintptr_t a2) {
+
+#if __riscv_xlen == 32
+    timer_arm(((uint64_t)a1 << 32) | a0);
+#else
+    timer_arm(a0);
+#endif
+    return 0;
+}
+
+static uintptr_t ecall_timer_disarm (uintptr_t a0, uintptr_t a1, uintptr_t a2) {
+
+    timer_disarm();
+    return 0;
+}
+
+static uintptr_t ecall_ipi_send (uintptr_t a0, uintptr_t a1, uintptr_t a2) {
+
+    ipi_send_mask(a0, a1);
+    return 0;
+}
+
+/* Handlers by mcause, NULL goes to default_exception_handler() */
+exception_handler_t exception_table[EXCEPTION_NUM_CAUSES];
+
+/* Called by exception_entry_asm in handlers.S, NULL returns ECALL_ERR_NOSYS */
+ecall_service_t ecall_services[ECALL_NUM_SERVICES] = {
+    [ECALL_SVC_HARTID]          = ecall_hartid,
+    [ECALL_SVC_TIMER_ARM]       = ecall_timer_arm,
+    [ECALL_SVC_TIMER_DISARM]    = ecall_timer_disarm,
+    [ECALL_SVC_IPI_SEND]        = ecall_ipi_send,
+};
+
+/* Install a handler for one exception cause, NULL restores the default.
+ * ecall causes never reach the table, add a service with ecall_register() */
+uint32_t exception_register (uint32_t cause, exception_handler_t handler) {
+
+    if ((cause >= EXCEPTION_NUM_CAUSES) || (cause == CAUSE_USER_ECALL) ||
+        (cause == CAUSE_SUPERVISOR_ECALL) || (cause == CAUSE_MACHINE_ECALL)) {
+        return EXCEPTION_ERR_CAUSE;
+    }
+
+    __atomic_store_n(&exception_table[cause], handler, __ATOMIC_RELEASE);
+
+    return EXCEPTION_OK;
+}
+
+/* Install an ecall service, NULL removes it */
+uint32_t ecall_register (uint32_t service, ecall_service_t func) {
+
+    if (service >= ECALL_NUM_SERVICES) {
+        return EXCEPTION_ERR_SERVICE;
+    }
+
+    __atomic_store_n(&ecall_services[service], func, __ATOMIC_RELEASE);
+
+    return EXCEPTION_OK;
+}
+
+/* Every exception but ecall lands here from exception_entry_asm, through vector_far_glue */
+void exception_dispatch (void) {
+
+    uintptr_t mcause = read_csr(mcause);
+    uintptr_t code = MCAUSE_CODE(mcause);
+    exception_handler_t handler = NULL;
+
+    if (code < EXCEPTION_NUM_CAUSES) {
+        handler = __atomic_load_n(&exception_table[code], __ATOMIC_ACQUIRE);
+    }
+
+    if (handler) {
+        handler(mcause, read_csr(mepc), read_csr(mtval));
+    } else {
+        // unhandled, print the diagnostics and exit
+        default_exception_handler();
+    }
+}
@@ -0,0 +1,86 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#ifndef _EXCEPTION_H_
+#define _EXCEPTION_H_
+
+#include "interrupts.h"
+
+/*****************************************************************************
+ * Synchronous exception dispatch and M-mode services through ecall.
+ *
+ * IRQ_0 enters exception_entry_asm in handlers.S. An ecall takes a fast
+ * path there: mepc is moved past the ecall and the service in a7 is called
+ * straight from ecall_services[], with no context save beyond t0 and ra.
+ * The ecall is a function call for the caller: a0 - a2 are the arguments,
+ * a0 the return value, and a0 - a7 and t0 - t6 are clobbered. Use
+ * ecall_service() rather than a bare ecall.
+ *
+ * Every other cause is looked up in exception_table[] by mcause, from C
+ * with the caller-saved registers saved. A handler that wants to resume
+ * after the faulting instruction must advance mepc itself. Causes with no
+ * handler end in default_exception_handler(), which prints and exits.
+ *****************************************************************************/
+
+#define EXCEPTION_NUM_CAUSES                    16          // mcause 0 - 15, keep in sync with handlers.S
+
+/* mcause exception codes */
+#define CAUSE_MISALIGNED_FETCH                  0
+#define CAUSE_FETCH_ACCESS                      1
+#define CAUSE_ILLEGAL_INSTRUCTION               2
+#define CAUSE_BREAKPOINT                        3
+#define CAUSE_MISALIGNED_LOAD                   4
+#define CAUSE_LOAD_ACCESS                       5
+#define CAUSE_MISALIGNED_STORE                  6
+#define CAUSE_STORE_ACCESS                      7
+#define CAUSE_USER_ECALL                        8
+#define CAUSE_SUPERVISOR_ECALL                  9
+#define CAUSE_MACHINE_ECALL                     11
+
+/* ecall services, a7 selects one. Keep ECALL_NUM_SERVICES in sync with handlers.S */
+#define ECALL_NUM_SERVICES                      8
+#define ECALL_SVC_HARTID                        0           // returns mhartid
+#define ECALL_SVC_TIMER_ARM                     1           // a0 = deadline, RV32: a0 = low, a1 = high word
+#define ECALL_SVC_TIMER_DISARM                  2
+#define ECALL_SVC_IPI_SEND                      3           // a0 = hart mask, a1 = IPI reason
+
+/* ecall return value for a service number with nothing registered */
+#define ECALL_ERR_NOSYS                         ((uintptr_t)-1)
+
+/* Return codes */
+#define EXCEPTION_OK                            0
+#define EXCEPTION_ERR_CAUSE                     0x1         // no such cause, or an ecall cause
+#define EXCEPTION_ERR_SERVICE                   0x2         // service number out of range
+
+typedef void (*exception_handler_t)(uintptr_t mcause, uintptr_t mepc, uintptr_t mtval);
+typedef uintptr_t (*ecall_service_t)(uintptr_t a0, uintptr_t a1, uintptr_t a2);
+
+extern exception_handler_t exception_table[EXCEPTION_NUM_CAUSES];
+extern ecall_service_t ecall_services[ECALL_NUM_SERVICES];
+
+/* Request an M-mode service. Clobbers are those of a function call, see handlers.S */
+static inline uintptr_t ecall_service (uintptr_t service, uintptr_t arg0, uintptr_t arg1, uintptr_t arg2) {
+
+    register uintptr_t a0 __asm__ ("a0") = arg0;
+    register uintptr_t a1 __asm__ ("a1") = arg1;
+    register uintptr_t a2 __asm__ ("a2") = arg2;
+    register uintptr_t a7 __asm__ ("a7") = service;
+
+    __asm__ volatile ("ecall"
+                      : "+r"(a0), "+r"(a1), "+r"(a2), "+r"(a7)
+                      :
+                      : "a3", "a4", "a5", "a6", "t0", "t1", "t2", "t3", "t4", "t5", "t6", "memory");
+
+    return a0;
+}
+
+/* Prototypes */
+uint32_t exception_register (uint32_t cause, exception_handler_t handler);
+uint32_t ecall_register (uint32_t service, ecall_service_t func);
+void exception_dispatch (void);
+
+#endif /* _EXCEPTION_H_ */
@@ -0,0 +1,216 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#include "interrupts.h"
+#include "executor.h"
+#include "ipi.h"
+
+struct executor_deque executor_deque[NUM_HARTS];
+struct executor_stats executor_stats[NUM_HARTS];
+
+/* Bitmask of harts sleeping in executor_idle_loop() */
+volatile uint32_t executor_idle_mask = 0;
+
+/* Owner only, interrupts disabled */
+static uint32_t executor_push (struct executor_deque *dq, const struct work_item *item) {
+
+    uint32_t b = dq->bottom;
+    uint32_t t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+
+    if ((int32_t)(b - t) >= EXECUTOR_DEQUE_SIZE) {
+        return EXECUTOR_ERR_FULL;
+    }
+
+    dq->buf[b & EXECUTOR_DEQUE_MASK] = *item;
+
+    // the item is written before a thief can see the new bottom
+    __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELEASE);
+
+    return EXECUTOR_OK;
+}
+
+/* Owner only, interrupts disabled. Returns TRUE if an item was taken */
+static uint32_t executor_pop (struct executor_deque *dq, struct work_item *item) {
+
+    uint32_t b = dq->bottom - 1;
+    uint32_t t;
+    uint32_t found = FALSE;
+
+    dq->bottom = b;
+
+    // claim the bottom item before looking at top, pairs with the fence in executor_steal()
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    t = dq->top;
+
+    if ((int32_t)(b - t) >= 0) {
+
+        *item = dq->buf[b & EXECUTOR_DEQUE_MASK];
+        found = TRUE;
+
+        if (b == t) {
+            // last item, a thief may be taking it at the same time
+            if (!__atomic_compare_exchange_n(&dq->top, &t, t + 1, FALSE, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                found = FALSE;
+            }
+            dq->bottom = b + 1;
+        }
+    } else {
+        // empty
+        dq->bottom = b + 1;
+    }
+
+    return found;
+}
+
+/* Any hart. Returns TRUE if an item was taken */
+static uint32_t executor_steal (struct executor_deque *dq, struct work_item *item) {
+
+    uint32_t t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+    uint32_t b;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    b = __atomic_load_n(&dq->bottom, __ATOMIC_ACQUIRE);
+
+    if ((int32_t)(b - t) > 0) {
+
+        // may race with the owner reusing the slot, the CAS discards the copy if so
+        *item = dq->buf[t & EXECUTOR_DEQUE_MASK];
+
+        if (__atomic_compare_exchange_n(&dq->top, &t, t + 1, FALSE, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static uint32_t executor_work_available (void) {
+
+    uint32_t i;
+
+    for (i = 0; i < NUM_HARTS; i++) {
+        if ((int32_t)(executor_deque[i].bottom - executor_deque[i].top) > 0) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/******************************************************************************
+ * Defer work to the executor of the current hart. Safe from minor handlers
+ * and from thread context. An idle hart, if any, is woken up to steal it.
+ *
+ * Returns EXECUTOR_ERR_FULL if the deque of this hart is full.
+ *****************************************************************************/
+uint32_t executor_submit (void (*func)(void *arg), void *arg) {
+
+    uint32_t hartid = metal_cpu_get_current_hartid();
+    struct work_item item = { func, arg };
+    uint32_t idle, bit, return_code;
+    uintptr_t mstatus;
+
+    __asm__ volatile ("csrrc %0, mstatus, %1" : "=r"(mstatus) : "r"(METAL_MIE_INTERRUPT));
+
+    return_code = executor_push(&executor_deque[hartid], &item);
+    if (return_code == EXECUTOR_OK) {
+        executor_stats[hartid].submitted++;
+    } else {
+        executor_stats[hartid].full++;
+    }
+
+    __asm__ volatile ("csrs mstatus, %0" :: "r"(mstatus & METAL_MIE_INTERRUPT));
+
+    if (return_code != EXECUTOR_OK) {
+        return return_code;
+    }
+
+    // the push is visible before we look for sleepers, pairs with executor_idle_loop()
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    // claim a sleeper by clearing its idle bit, so back to back submits wake different harts
+    idle = executor_idle_mask & ~(1 << hartid);
+    while (idle) {
+        bit = idle & -idle;
+        if (__atomic_fetch_and(&executor_idle_mask, ~bit, __ATOMIC_SEQ_CST) & bit) {
+            ipi_send(__builtin_ctz(bit), IPI_WAKE);
+            break;
+        }
+        // another submit claimed it first
+        idle = executor_idle_mask & ~(1 << hartid);
+    }
+
+    return EXECUTOR_OK;
+}
+
+/* Run one work item: our own newest first, otherwise steal the oldest from another hart.
+ * Returns TRUE if an item was run */
+uint32_t executor_run_one (uint32_t hartid) {
+
+    struct work_item item;
+    uint32_t i, victim, found;
+    uintptr_t mstatus;
+
+    __asm__ volatile ("csrrc %0, mstatus, %1" : "=r"(mstatus) : "r"(METAL_MIE_INTERRUPT));
+    found = executor_pop(&executor_deque[hartid], &item);
+    __asm__ volatile ("csrs mstatus, %0" :: "r"(mstatus & METAL_MIE_INTERRUPT));
+
+    // start with the next hart so thieves spread over victims
+    for (i = 1; (i < NUM_HARTS) && !found; i++) {
+        victim = (hartid + i) % NUM_HARTS;
+        if (executor_steal(&executor_deque[victim], &item)) {
+            executor_stats[hartid].stolen++;
+            found = TRUE;
+        }
+    }
+
+    if (!found) {
+        return FALSE;
+    }
+
+    item.func(item.arg);
+    executor_stats[hartid].executed++;
+
+    return TRUE;
+}
+
+/* Idle harts run and steal work here, and sleep in wfi when there is none */
+void executor_idle_loop (void) {
+
+    uint32_t hartid = metal_cpu_get_current_hartid();
+    uint32_t bit = 1 << hartid;
+
+    while (1) {
+
+        if (executor_run_one(hartid)) {
+            continue;
+        }
+
+        // advertise we are idle before the last check, so a submit either sees us or we see its work
+        interrupt_global_disable();
+        __atomic_fetch_or(&executor_idle_mask, bit, __ATOMIC_SEQ_CST);
+
+        if (!executor_work_available()) {
+            asm volatile ("wfi");
+        }
+
+        // a submit may have cleared it already when it claimed us
+        __atomic_fetch_and(&executor_idle_mask, ~bit, __ATOMIC_SEQ_CST);
+        interrupt_global_enable();
+    }
+}
+
+void executor_report (void) {
+
+    uint32_t i;
+
+    printf ("Executor:\n");
+    for (i = 0; i < NUM_HARTS; i++) {
+        printf ("  hart %d submitted %d executed %d stolen %d full %d\n", i, executor_stats[i].submitted,
+                executor_stats[i].executed, executor_stats[i].stolen, executor_stats[i].full);
+    }
+}
@@ -0,0 +1,65 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#ifndef _EXECUTOR_H_
+#define _EXECUTOR_H_
+
+#include "interrupts.h"
+
+/*****************************************************************************
+ * Run-to-completion executor with per-hart Chase-Lev work-stealing deques.
+ *
+ * A minor handler defers work with executor_submit(), which pushes onto the
+ * deque of the hart the interrupt was routed to. That hart runs its own
+ * work from the bottom of the deque, and idle harts steal from the top of
+ * other harts' deques, so bursts are absorbed without changing APLIC_TARGET.
+ *
+ * Only the owning hart pushes and pops its deque. Owner operations run with
+ * interrupts disabled, so a handler can never push in the middle of a pop.
+ * Thieves synchronize with a CAS on top.
+ *
+ * Idle harts sleep in wfi in executor_idle_loop(), and executor_submit()
+ * wakes one of them with an IPI_WAKE. The woken hart's idle bit is cleared
+ * by the submit, so each item wakes a different hart.
+ *****************************************************************************/
+
+#define EXECUTOR_DEQUE_SIZE                     64          // must be a power of 2
+#define EXECUTOR_DEQUE_MASK                     (EXECUTOR_DEQUE_SIZE - 1)
+
+/* Return codes */
+#define EXECUTOR_OK                             0
+#define EXECUTOR_ERR_FULL                       0x1         // deque full, run the work inline or drop it
+
+struct work_item {
+    void (*func)(void *arg);
+    void *arg;
+};
+
+/* top and bottom are free running and wrap, compare them with signed differences */
+struct executor_deque {
+    volatile uint32_t top __attribute__ ((aligned(CACHE_LINE_SIZE)));       // thieves steal here
+    volatile uint32_t bottom __attribute__ ((aligned(CACHE_LINE_SIZE)));    // owner pushes and pops here
+    struct work_item buf[EXECUTOR_DEQUE_SIZE];
+} __attribute__ ((aligned(CACHE_LINE_SIZE)));
+
+struct executor_stats {
+    uint32_t submitted;
+    uint32_t executed;                          // items run on this hart, own or stolen
+    uint32_t stolen;                            // items this hart took from other harts
+    uint32_t full;                              // submits refused because the deque was full
+} __attribute__ ((aligned(CACHE_LINE_SIZE)));
+
+extern struct executor_deque executor_deque[NUM_HARTS];
+extern struct executor_stats executor_stats[NUM_HARTS];
+
+/* Prototypes */
+uint32_t executor_submit (void (*func)(void *arg), void *arg);
+uint32_t executor_run_one (uint32_t hartid);
+void executor_idle_loop (void);
+void executor_report (void);
+
+#endif /* _EXECUTOR_H_ */
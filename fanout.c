@@ -0,0 +1,130 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#include "interrupts.h"
+#include "fanout.h"
+#include "ipi.h"
+
+struct fanout_inbox fanout_inbox[NUM_HARTS];
+
+/* Claim a slot with a CAS on head and fill it. Returns FALSE if the inbox is full */
+static uint32_t fanout_inbox_push (struct fanout_inbox *inbox, const struct fanout_event *event) {
+
+    uint32_t pos = __atomic_load_n(&inbox->head, __ATOMIC_RELAXED);
+    struct fanout_slot *slot;
+    uint32_t lap, seq;
+
+    for (;;) {
+        slot = &inbox->ring[pos & FANOUT_INBOX_MASK];
+        lap = 2 * (pos >> FANOUT_INBOX_SHIFT);
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+        if (seq == lap) {
+            // on failure pos is reloaded with the current head
+            if (__atomic_compare_exchange_n(&inbox->head, &pos, pos + 1, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if ((int32_t)(seq - lap) < 0) {
+            // the owner has not drained this slot from the previous lap
+            return FALSE;
+        } else {
+            pos = __atomic_load_n(&inbox->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->event = *event;
+    __atomic_store_n(&slot->seq, lap + 1, __ATOMIC_RELEASE);
+
+    return TRUE;
+}
+
+/* Owner only. Returns FALSE if the inbox is empty */
+static uint32_t fanout_inbox_pop (struct fanout_inbox *inbox, struct fanout_event *event) {
+
+    struct fanout_slot *slot = &inbox->ring[inbox->tail & FANOUT_INBOX_MASK];
+    uint32_t lap = 2 * (inbox->tail >> FANOUT_INBOX_SHIFT);
+
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != lap + 1) {
+        return FALSE;
+    }
+
+    *event = slot->event;
+    __atomic_store_n(&slot->seq, lap + 2, __ATOMIC_RELEASE);
+    inbox->tail++;
+
+    return TRUE;
+}
+
+/* Replace the fan-out sources a hart receives. handler may be NULL to only count the events */
+void fanout_subscribe (uint32_t hartid, uint32_t source_mask, fanout_handler_t handler) {
+
+    fanout_inbox[hartid].handler = handler;
+
+    // the handler is in place before the first publish can see the mask
+    __atomic_store_n(&fanout_inbox[hartid].subscribed, source_mask, __ATOMIC_RELEASE);
+}
+
+/******************************************************************************
+ * Publish an event to every hart subscribed to source, the publishing hart
+ * included. Usually called from the minor handler of the owning hart, after
+ * the device has been cleared.
+ *
+ * Returns the mask of harts the event was delivered to.
+ *****************************************************************************/
+uint32_t fanout_publish (uint32_t source, uint32_t int_id, uint32_t data) {
+
+    struct fanout_event event = { source, int_id, data };
+    uint32_t h, hart_mask = 0;
+
+    for (h = 0; h < NUM_HARTS; h++) {
+
+        if (!(__atomic_load_n(&fanout_inbox[h].subscribed, __ATOMIC_ACQUIRE) & FANOUT_BIT(source))) {
+            continue;
+        }
+
+        if (fanout_inbox_push(&fanout_inbox[h], &event)) {
+            hart_mask |= 1 << h;
+        } else {
+            __atomic_fetch_add(&fanout_inbox[h].dropped, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    // one MSIP per subscriber, the reason bit is set after the events are written
+    if (hart_mask) {
+        ipi_send_mask(hart_mask, IPI_FANOUT);
+    }
+
+    return hart_mask;
+}
+
+/* Called from software_handler_asm on the interrupt stack when IPI_FANOUT was set */
+void fanout_drain (void) {
+
+    struct fanout_inbox *inbox = &fanout_inbox[metal_cpu_get_current_hartid()];
+    struct fanout_event event;
+
+    while (fanout_inbox_pop(inbox, &event)) {
+
+        if (inbox->handler) {
+            inbox->handler(&event);
+        }
+        inbox->delivered++;
+    }
+}
+
+void fanout_report (void) {
+
+    uint32_t h;
+
+    printf ("Fan-out inboxes:\n");
+    for (h = 0; h < NUM_HARTS; h++) {
+        if (fanout_inbox[h].subscribed) {
+            printf ("  hart %d: sources 0x%x, %d delivered, %d dropped\n", h,
+                    fanout_inbox[h].subscribed, fanout_inbox[h].delivered, fanout_inbox[h].dropped);
+        }
+    }
+}
@@ -0,0 +1,78 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#ifndef _FANOUT_H_
+#define _FANOUT_H_
+
+#include "interrupts.h"
+
+/*****************************************************************************
+ * Fan-out of one APLIC source to several harts.
+ *
+ * In direct mode a source targets a single hart. For events every hart must
+ * act on, the minor handler on that owning hart claims and clears the
+ * device as usual, then calls fanout_publish(). The event is copied into
+ * the inbox of every hart subscribed to its fan-out source, and all of
+ * them get a single ipi_send_mask() with IPI_FANOUT.
+ *
+ * software_handler_asm drains the whole inbox with fanout_drain() on the
+ * interrupt stack, calling the handler the hart subscribed with for each
+ * event. Events published while the IPI is in flight are batched into the
+ * same drain.
+ *
+ * Fan-out sources are small numbers, not APLIC interrupt IDs, so a hart
+ * subscribes to several of them with one mask of FANOUT_BIT()s.
+ *
+ * Inboxes are bounded multi-producer rings. Any hart can publish, only the
+ * owner drains. An event for a full inbox is dropped and counted.
+ *****************************************************************************/
+
+/* Fan-out sources */
+#define FANOUT_SRC_BEU                          0           // bus error, published by the BEU handlers
+#define FANOUT_SRC_CONFIG                       1           // global configuration changed
+#define FANOUT_MAX_SOURCES                      32
+
+#define FANOUT_BIT(source)                      (1 << (source))
+
+#define FANOUT_INBOX_SHIFT                      4
+#define FANOUT_INBOX_SIZE                       (1 << FANOUT_INBOX_SHIFT)
+#define FANOUT_INBOX_MASK                       (FANOUT_INBOX_SIZE - 1)
+
+struct fanout_event {
+    uint32_t source;                            // FANOUT_SRC_*
+    uint32_t int_id;                            // APLIC source that raised it, 0 if none
+    uint32_t data;                              // source specific, the accrued value for a BEU
+};
+
+typedef void (*fanout_handler_t)(const struct fanout_event *event);
+
+/* A slot holds an event for lap n when seq is 2n + 1, and is free for lap n when seq is 2n */
+struct fanout_slot {
+    struct fanout_event event;
+    volatile uint32_t seq;
+};
+
+/* Per-hart inbox, on its own cache lines */
+struct fanout_inbox {
+    volatile uint32_t head;                     // next position to publish, claimed by CAS
+    uint32_t tail;                              // next position to drain, owner only
+    volatile uint32_t subscribed;               // FANOUT_BIT mask
+    fanout_handler_t handler;
+    volatile uint32_t delivered;
+    volatile uint32_t dropped;
+    struct fanout_slot ring[FANOUT_INBOX_SIZE];
+} __attribute__ ((aligned(CACHE_LINE_SIZE)));
+
+extern struct fanout_inbox fanout_inbox[NUM_HARTS];
+
+/* Prototypes */
+void fanout_subscribe (uint32_t hartid, uint32_t source_mask, fanout_handler_t handler);
+uint32_t fanout_publish (uint32_t source, uint32_t int_id, uint32_t data);
+void fanout_drain (void);
+void fanout_report (void);
+
+#endif /* _FANOUT_H_ */
@@ -0,0 +1,198 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#include "interrupts.h"
+#include "fast_irq.h"
+#include "vector_table.h"
+#include "aplic_registry.h"
+#include "aplic_cluster.h"
+#include "clocksource.h"
+#include "aplic_tune.h"
+#include "aplic_shadow.h"
+
+static uint32_t fast_irq_local_line_exists (uint32_t local_irq) {
+
+    return (local_irq >= FAST_IRQ_FIRST_LOCAL) &&
+           (local_irq < (FAST_IRQ_FIRST_LOCAL + FAST_IRQ_LOCAL_LINES)) &&
+           (local_irq < VECTOR_TABLE_ENTRIES);
+}
+
+/******************************************************************************
+ * Bind a device to the cheapest interrupt path available on this hart.
+ *
+ * The local line in config is used if the design has it and its vector
+ * table slot can be patched: the isr is installed directly if given and in
+ * range, otherwise the handler through a trampoline. Failing that, the
+ * APLIC source in config is routed to this hart with the handler as its
+ * minor handler.
+ *
+ * Returns FAST_IRQ_OK with the lane in binding, FAST_IRQ_ERR_NO_LANE if
+ * neither path exists, or the error from aplic_int_enable_disable().
+ *****************************************************************************/
+uint32_t fast_irq_bind (const struct fast_irq_config *config, struct fast_irq_binding *binding) {
+
+    uint32_t hartid = metal_cpu_get_current_hartid();
+    uint32_t rc = VECTOR_TABLE_ERR_IRQ;
+
+    binding->lane = FAST_IRQ_LANE_NONE;
+
+    if (config->handler == NULL) {
+        return FAST_IRQ_ERR_HANDLER;
+    }
+
+    if (fast_irq_local_line_exists(config->local_irq)) {
+
+        if (config->isr) {
+            rc = vector_table_install(config->local_irq, config->isr, VECTOR_TYPE_ISR);
+        }
+        if (rc != VECTOR_TABLE_OK) {
+            rc = vector_table_install(config->local_irq, config->handler, VECTOR_TYPE_FUNC);
+        }
+
+        if (rc == VECTOR_TABLE_OK) {
+            interrupt_local_enable(config->local_irq);
+            binding->lane = FAST_IRQ_LANE_LOCAL;
+            binding->irq = config->local_irq;
+            return FAST_IRQ_OK;
+        }
+
+        printf ("Local IRQ %d is not available, routing through the APLIC\n", config->local_irq);
+    }
+
+    if (config->int_id == 0) {
+        return FAST_IRQ_ERR_NO_LANE;
+    }
+
+    aplic_handler_register(config->int_id, config->handler);
+    rc = aplic_int_enable_disable(hartid, config->int_id, config->source_mode, config->priority, MACHINE_INTS);
+    if (rc) {
+        return rc;
+    }
+
+    binding->lane = FAST_IRQ_LANE_APLIC;
+    binding->irq = config->int_id;
+
+    return FAST_IRQ_OK;
+}
+
+/* Undo fast_irq_bind(), on the hart that did the bind */
+void fast_irq_unbind (struct fast_irq_binding *binding) {
+
+    uint32_t hartid = metal_cpu_get_current_hartid();
+
+    switch (binding->lane)
+    {
+        case FAST_IRQ_LANE_LOCAL:
+            interrupt_local_disable(binding->irq);
+            vector_table_uninstall(binding->irq);
+            break;
+
+        case FAST_IRQ_LANE_APLIC:
+            // an inactive source is disabled and can not become pending
+            aplic_int_enable_disable(hartid, binding->irq, APLIC_SOURCECFG_MODE_INACTIVE, aplic_shadow_priority(binding->irq),
+                                     MACHINE_INTS);
+            aplic_handler_unregister(binding->irq);
+            break;
+
+        default:
+            break;
+    }
+
+    binding->lane = FAST_IRQ_LANE_NONE;
+}
+
+/*
+ * Latency benchmark
+ */
+static volatile uint64_t fast_irq_bench_stamp;
+static uint32_t fast_irq_bench_line;
+
+static void fast_irq_bench_local_handler (void) {
+
+    fast_irq_bench_stamp = clocksource_read_cycles();
+
+    // the benchmark raises the line through mip, so it is acked there. A device would be acked here
+    interrupt_local_pending_disable(fast_irq_bench_line);
+}
+
+static void __attribute__((interrupt)) fast_irq_bench_local_isr (void) {
+
+    fast_irq_bench_stamp = clocksource_read_cycles();
+    interrupt_local_pending_disable(fast_irq_bench_line);
+}
+
+static void fast_irq_bench_aplic_handler (void) {
+
+    // edge triggered source, the claim already cleared it
+    fast_irq_bench_stamp = clocksource_read_cycles();
+}
+
+static void fast_irq_bench_run (const struct fast_irq_config *config, const char *name) {
+
+    struct fast_irq_binding binding;
+    uint64_t start, latency, deadline, min = ~0ULL, max = 0, sum = 0;
+    uint32_t i, lane, taken = 0;
+
+    if (fast_irq_bind(config, &binding) != FAST_IRQ_OK) {
+        printf ("  %-12s not available\n", name);
+        return;
+    }
+
+    for (i = 0; i < FAST_IRQ_BENCH_ITERATIONS; i++) {
+
+        fast_irq_bench_stamp = 0;
+        start = clocksource_read_cycles();
+
+        if (binding.lane == FAST_IRQ_LANE_LOCAL) {
+            interrupt_local_pending_enable(binding.irq);
+        } else {
+            write_word(APLIC_INST_SETIPNUM_ADDR(aplic_source_base(binding.irq)), binding.irq);
+        }
+
+        deadline = clocksource_read() + clocksource_us_to_ticks(FAST_IRQ_BENCH_TIMEOUT_US);
+        while (!fast_irq_bench_stamp && (clocksource_read() < deadline));
+
+        if (!fast_irq_bench_stamp) {
+            continue;
+        }
+
+        latency = fast_irq_bench_stamp - start;
+        min = (latency < min) ? latency : min;
+        max = (latency > max) ? latency : max;
+        sum += latency;
+        taken++;
+    }
+
+    lane = binding.lane;
+    fast_irq_unbind(&binding);
+
+    if (taken == 0) {
+        printf ("  %-12s no interrupts taken!\n", name);
+        return;
+    }
+
+    printf ("  %-12s %s lane: min %d avg %d max %d cycles, %d of %d taken\n", name,
+            (lane == FAST_IRQ_LANE_LOCAL) ? "local" : "APLIC",
+            (uint32_t)min, (uint32_t)(sum / taken), (uint32_t)max, taken, FAST_IRQ_BENCH_ITERATIONS);
+}
+
+/* Trigger-to-handler latency in mcycles, through a local line and through an APLIC source.
+ * Interrupts must be enabled on this hart */
+void fast_irq_benchmark (uint32_t local_irq, uint32_t int_id) {
+
+    const struct fast_irq_config local_isr = { local_irq, 0, 0, 0, fast_irq_bench_local_handler, fast_irq_bench_local_isr };
+    const struct fast_irq_config local = { local_irq, 0, 0, 0, fast_irq_bench_local_handler, NULL };
+    const struct fast_irq_config aplic = { FAST_IRQ_NO_LOCAL, int_id, APLIC_SOURCECFG_MODE_RISE_EDGE,
+                                           aplic_tune_lookup(int_id, PRIO_THRESH_1), fast_irq_bench_aplic_handler, NULL };
+
+    fast_irq_bench_line = local_irq;
+
+    printf ("Interrupt latency, trigger to handler entry:\n");
+    fast_irq_bench_run(&local_isr, "local isr");
+    fast_irq_bench_run(&local, "local func");
+    fast_irq_bench_run(&aplic, "APLIC");
+}
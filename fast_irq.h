@@ -0,0 +1,73 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#ifndef _FAST_IRQ_H_
+#define _FAST_IRQ_H_
+
+#include "interrupts.h"
+
+/*****************************************************************************
+ * Fast lane for latency critical devices.
+ *
+ * A device wired to a local interrupt line (IRQ 16 and up) is taken
+ * straight from its slot in __mtvec_clint_vector_table, with no CLAIMI or
+ * TOPI MMIO read. fast_irq_bind() installs the handler in that slot and
+ * sets the line in mie of the calling hart, so bind from the hart that owns
+ * the line. When the design has no such line, or the vector table can not
+ * be patched, the device is routed through the APLIC to the calling hart.
+ *
+ * The handler acknowledges the device itself in both lanes. It is a plain
+ * C function, called through a trampoline on the local lane and from
+ * external_handler on the APLIC lane. An optional __attribute__((interrupt))
+ * isr is jumped to directly on the local lane, the cheapest path the core
+ * has, but it runs on the interrupted stack.
+ *
+ * fast_irq_benchmark() compares trigger-to-handler latency of both lanes.
+ *****************************************************************************/
+
+#if defined(METAL_MAX_LOCAL_EXT_INTERRUPTS)
+#define FAST_IRQ_LOCAL_LINES                    METAL_MAX_LOCAL_EXT_INTERRUPTS
+#else
+#define FAST_IRQ_LOCAL_LINES                    0
+#endif
+
+#define FAST_IRQ_FIRST_LOCAL                    16          // local external interrupts start at mcause 16
+#define FAST_IRQ_NO_LOCAL                       0           // local_irq value for a device with no local line
+
+/* lanes */
+#define FAST_IRQ_LANE_NONE                      0
+#define FAST_IRQ_LANE_LOCAL                     1
+#define FAST_IRQ_LANE_APLIC                     2
+
+#define FAST_IRQ_BENCH_ITERATIONS               32
+#define FAST_IRQ_BENCH_TIMEOUT_US               1000
+
+/* Return codes */
+#define FAST_IRQ_OK                             0
+#define FAST_IRQ_ERR_NO_LANE                    0x1         // no local line and no APLIC source
+#define FAST_IRQ_ERR_HANDLER                    0x2
+
+struct fast_irq_config {
+    uint32_t local_irq;                         // local line, or FAST_IRQ_NO_LOCAL
+    uint32_t int_id;                            // APLIC source for the fallback, 0 for none
+    uint32_t source_mode;                       // APLIC_SOURCECFG_MODE_*
+    uint32_t priority;
+    void (*handler)(void);                      // plain function, acks the device
+    void (*isr)(void);                          // optional interrupt-attribute version for the local lane
+};
+
+struct fast_irq_binding {
+    uint32_t lane;
+    uint32_t irq;                               // local IRQ or APLIC interrupt ID, depending on the lane
+};
+
+/* Prototypes */
+uint32_t fast_irq_bind (const struct fast_irq_config *config, struct fast_irq_binding *binding);
+void fast_irq_unbind (struct fast_irq_binding *binding);
+void fast_irq_benchmark (uint32_t local_irq, uint32_t int_id);
+
+#endif /* _FAST_IRQ_H_ */
@@ -0,0 +1,64 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#include "interrupts.h"
+#include "fp_context.h"
+
+#if FP_CONTEXT_PRESENT
+/* Per-hart save area for the interrupted FP state */
+struct fp_context fp_save_area[NUM_HARTS];
+#endif
+
+/* Make the FPU usable for an FP minor handler, saving only the state the interrupted code has.
+ * Returns mstatus.FS as it was on entry, to pass to fp_context_exit() */
+uintptr_t fp_context_enter (uint32_t hartid) {
+
+    uintptr_t fs = read_csr(mstatus) & MSTATUS_FS_MASK;
+
+#if FP_CONTEXT_PRESENT
+    switch (fs)
+    {
+        case MSTATUS_FS_OFF:
+            // nothing live, switch the FPU on for the handler
+            __asm__ volatile ("csrs mstatus, %0" :: "r"(MSTATUS_FS_INITIAL));
+            break;
+        case MSTATUS_FS_INITIAL:
+            // registers were never written, only the rounding mode and flags matter
+            fp_save_area[hartid].fcsr = read_csr(fcsr);
+            break;
+        default:
+            // Clean or Dirty, interrupted code has live registers and no other copy of them
+            fp_context_save_regs(&fp_save_area[hartid]);
+            break;
+    }
+#endif
+
+    return fs;
+}
+
+/* Put back the interrupted FP state and mstatus.FS */
+void fp_context_exit (uint32_t hartid, uintptr_t fs) {
+
+#if FP_CONTEXT_PRESENT
+    switch (fs)
+    {
+        case MSTATUS_FS_OFF:
+            break;
+        case MSTATUS_FS_INITIAL:
+            write_csr(fcsr, fp_save_area[hartid].fcsr);
+            // the handler may have written registers that were not saved, they are no longer initial
+            fs = MSTATUS_FS_DIRTY;
+            break;
+        default:
+            fp_context_restore_regs(&fp_save_area[hartid]);
+            break;
+    }
+
+    __asm__ volatile ("csrc mstatus, %0" :: "r"(MSTATUS_FS_MASK));
+    __asm__ volatile ("csrs mstatus, %0" :: "r"(fs));
+#endif
+}
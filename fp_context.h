@@ -0,0 +1,68 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#ifndef _FP_CONTEXT_H_
+#define _FP_CONTEXT_H_
+
+#include "interrupts.h"
+
+/*****************************************************************************
+ * Lazy floating point context for APLIC minor handlers.
+ *
+ * external_handler is entered through external_handler_asm in handlers.S,
+ * which only saves integer registers. Minor handlers registered with
+ * aplic_handler_register_fp() are wrapped in fp_context_enter/exit:
+ *  - mstatus.FS Off:            FP is switched on for the handler, then off
+ *  - mstatus.FS Initial:        only fcsr is saved and restored, and FS is
+ *                               left Dirty since the registers no longer
+ *                               hold their initial values
+ *  - mstatus.FS Clean or Dirty: the interrupted code has live FP registers,
+ *                               all 32 and fcsr go to this hart's save area
+ * Otherwise mstatus.FS is put back as it was on entry. Handlers that are not marked
+ * as using FP must not touch the FPU, and cost nothing extra.
+ *
+ * The save area is per hart since external_handler does not nest, so the
+ * interrupted stack does not grow by the size of the FP register file.
+ *****************************************************************************/
+
+#define MSTATUS_FS_MASK                         0x6000
+#define MSTATUS_FS_OFF                          0x0000
+#define MSTATUS_FS_INITIAL                      0x2000
+#define MSTATUS_FS_CLEAN                        0x4000
+#define MSTATUS_FS_DIRTY                        0x6000
+
+#if defined(__riscv_flen)
+#define FP_CONTEXT_PRESENT                      TRUE
+#else
+#define FP_CONTEXT_PRESENT                      FALSE
+#endif
+
+#if FP_CONTEXT_PRESENT
+#if __riscv_flen == 64
+typedef uint64_t fp_reg_t;
+#else
+typedef uint32_t fp_reg_t;
+#endif
+
+/* Layout is shared with fp_context_save_regs in handlers.S */
+struct fp_context {
+    fp_reg_t f[32];
+    uint32_t fcsr;
+} __attribute__ ((aligned(CACHE_LINE_SIZE)));
+
+extern struct fp_context fp_save_area[NUM_HARTS];
+
+/* handlers.S */
+void fp_context_save_regs (struct fp_context *ctx);
+void fp_context_restore_regs (struct fp_context *ctx);
+#endif /* #if FP_CONTEXT_PRESENT */
+
+/* Prototypes */
+uintptr_t fp_context_enter (uint32_t hartid);
+void fp_context_exit (uint32_t hartid, uintptr_t fs);
+
+#endif /* _FP_CONTEXT_H_ */
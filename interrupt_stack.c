@@ -0,0 +1,50 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#include "interrupts.h"
+#include "interrupt_stack.h"
+
+struct interrupt_stack interrupt_stack[NUM_HARTS];
+
+/* Fill this hart's interrupt stack and point mscratch at its top.
+ * Must run before mtvec is written, a trap with mscratch at 0 has no stack */
+void interrupt_stack_init (uint32_t hartid) {
+
+    uint32_t i;
+
+    for (i = 0; i < (INTERRUPT_STACK_SIZE / sizeof(uint32_t)); i++) {
+        interrupt_stack[hartid].words[i] = INTERRUPT_STACK_FILL;
+    }
+
+    write_csr(mscratch, (uintptr_t)&interrupt_stack[hartid + 1]);
+}
+
+/* Deepest use of a hart's interrupt stack so far, in bytes. The stack grows down */
+uint32_t interrupt_stack_high_water (uint32_t hartid) {
+
+    uint32_t i;
+
+    for (i = 0; i < (INTERRUPT_STACK_SIZE / sizeof(uint32_t)); i++) {
+        if (interrupt_stack[hartid].words[i] != INTERRUPT_STACK_FILL) {
+            break;
+        }
+    }
+
+    return INTERRUPT_STACK_SIZE - (i * sizeof(uint32_t));
+}
+
+void interrupt_stack_report (void) {
+
+    uint32_t i, used;
+
+    printf ("Interrupt stacks (%d bytes each):\n", INTERRUPT_STACK_SIZE);
+    for (i = 0; i < NUM_HARTS; i++) {
+        used = interrupt_stack_high_water(i);
+        printf ("  hart %d high-water %d bytes%s\n", i, used,
+                (used == INTERRUPT_STACK_SIZE) ? " - OVERFLOW?" : "");
+    }
+}
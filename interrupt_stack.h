@@ -0,0 +1,47 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#ifndef _INTERRUPT_STACK_H_
+#define _INTERRUPT_STACK_H_
+
+#include "interrupts.h"
+
+/*****************************************************************************
+ * Dedicated per-hart interrupt stacks.
+ *
+ * While a hart runs thread code, mscratch holds the top of its interrupt
+ * stack. The trap entries in handlers.S swap sp and mscratch before pushing
+ * anything, and swap them back right before mret, so trap frames always
+ * land in the same cache-aligned memory and task stacks only need room for
+ * the task itself.
+ *
+ * A trap taken while already on the interrupt stack (an exception in a
+ * handler) swaps back to the interrupted task stack, and returns to the
+ * interrupt stack on exit.
+ *
+ * Handlers installed with VECTOR_TYPE_ISR are entered straight from the
+ * vector table and run on the interrupted stack.
+ *
+ * Stacks are filled with INTERRUPT_STACK_FILL at init, and the deepest word
+ * that changed gives the high-water mark.
+ *****************************************************************************/
+
+#define INTERRUPT_STACK_SIZE                    2048        // bytes per hart, multiple of CACHE_LINE_SIZE
+#define INTERRUPT_STACK_FILL                    0xA5A5A5A5
+
+struct interrupt_stack {
+    uint32_t words[INTERRUPT_STACK_SIZE / sizeof(uint32_t)];
+} __attribute__ ((aligned(CACHE_LINE_SIZE)));
+
+extern struct interrupt_stack interrupt_stack[NUM_HARTS];
+
+/* Prototypes */
+void interrupt_stack_init (uint32_t hartid);
+uint32_t interrupt_stack_high_water (uint32_t hartid);
+void interrupt_stack_report (void);
+
+#endif /* _INTERRUPT_STACK_H_ */
@@ -6,6 +6,16 @@
 #include <metal/machine.h>
 
 #include "interrupts.h"
+#include "timer.h"
+#include "clocksource.h"
+#include "fanout.h"
+#include "aplic_tune.h"
+#include "beu_log.h"
+#include "aplic_registry.h"
+#include "fp_context.h"
+#include "aplic_cluster.h"
+#include "console.h"
+#include "aplic_shadow.h"
 
 /* external globals */
 extern uint32_t external_isr_counter;
@@ -14,9 +24,6 @@ extern uint32_t software_isr_counter;
 extern uint32_t l2_isr_counter;
 extern uint32_t beu_accrued_value;
 
-/* PLIC software table */
-extern void (*aplic_minor_func[])(int);
-
 /*
  *
  *
@@ -41,52 +48,93 @@ void __attribute__((interrupt)) software_handler (void) {
 }
 
 // Timer handler is major interrupt #7
-void __attribute__((interrupt)) timer_handler (void) {
+// Entered from timer_handler_asm in handlers.S, on the interrupt stack
+void timer_handler (void) {
 
+    // first thing, so timer callbacks can measure wakeup latency
+    uint64_t entry_cycles = clocksource_read_cycles();
     int hartid = metal_cpu_get_current_hartid();
 
-    timer_isr_counter++;
+    /* Disarm expired deadlines and move mtimecmp to the next one, or way in the future.
+     * Only the application timer is counted, wait deadlines just wake the hart up. See timer.c */
+    if (timer_service(hartid, entry_cycles)) {
+        timer_isr_counter++;
+    }
 #if DEBUG_PRINT
     //printf ("Timer Handler! Count: %d\n", timer_isr_counter);
 #endif
-
-    /* Generic - set to some time way in the future to clear timer pending interrupt */
-    write_dword(CLINT_MTIMECMP_ADDR_HART(hartid), (read_dword(CLINT_MTIME_BASE_ADDR) + 0x00A00000));	// write msip to value in the future
-
-    asm ("fence ow, ow");	// system IO release to sync the mtimecmp write. This prevents spurious interrupts
 }
 
 // External Interrupt is major interrupt #11 - handles all global interrupts from APLIC
-void __attribute__((interrupt)) external_handler (void) {
+// Entered from external_handler_asm in handlers.S, which saves integer registers only
+void external_handler (void) {
 
-    uintptr_t claimi, int_id, prio, mip, countdown, aplic_pending, topi = 0;
+    uintptr_t claimi, int_id, prio, mip, countdown, aplic_pending, fs, topi = 0;
     uint32_t hartid = metal_cpu_get_current_hartid();
+#if APLIC_TUNE
+    uint64_t claimed;
+#endif
+    aplic_minor_handler_t handler;
+
+    // Debug prints from the console interrupt would raise it again, see console.c
+    uint32_t quiet = FALSE;
+
+    // Only our local APLIC delivers to this hart, see aplic_cluster.h
+    uintptr_t idc = aplic_hart_idc(hartid);
+
+    // Handlers may be swapped at runtime by other harts, see aplic_registry.c
+    aplic_handler_dispatch_enter(hartid);
 
     do {
         // Read claimi
-        claimi = read_word(APLIC_CLAIMI_ADDR(hartid));
+        claimi = read_word(idc + APLIC_IDC_CLAIMI);
+#if APLIC_TUNE
+        claimed = clocksource_read_cycles();
+#endif
         int_id = (claimi >> 16) & 0x3FF;		// ID is [25:16]
         prio = (claimi & 0x3F); 				// Priority is [7:0]
+        quiet = (int_id == CONSOLE_INT_NUM);
 
         if (int_id != 0) {
 #if DEBUG_PRINT
-            printf ("Calling minor function for interrupt ID %d\n", int_id);
+            if (!quiet) {
+                printf ("Calling minor function for interrupt ID %d\n", int_id);
+            }
 #endif
             // Call minor function based on claimi [25:16] which is ID, and [7:0] is priority
-            aplic_minor_func[int_id](int_id);
+            // Load the handler before its FP flag, the acquire orders the two
+            handler = aplic_handler_get(int_id);
+
+            // Save the interrupted FP state only if this handler uses the FPU
+            if (aplic_handler_uses_fp(int_id)) {
+                fs = fp_context_enter(hartid);
+                handler();
+                fp_context_exit(hartid, fs);
+            } else {
+                handler();
+            }
+
+#if APLIC_TUNE
+            // arrival rate and handler cost, see aplic_tune.h
+            aplic_tune_record(int_id, claimed, clocksource_read_cycles());
+#endif
 
 #if DEBUG_PRINT
-            printf ("Returned from minor handler\n");
+            if (!quiet) {
+                printf ("Returned from minor handler\n");
+            }
 #endif
             // Optional step for level triggered interrupt to clear the source - just an example, not a real function
             // aplic_clear_source(int_id); 
 
             // Read topi to see if a different (higher priority) enabled & pending interrupt comes in
-            topi = read_word(APLIC_TOPI_ADDR(hartid));
+            topi = read_word(idc + APLIC_IDC_TOPI);
             asm ("fence ir, iorw"); 	// Optional: System IO acquire for the topi read synchronization before we check it
 
 #if DEBUG_PRINT
-            printf ("Just read topi: 0x%lx\n", topi);
+            if (!quiet) {
+                printf ("Just read topi: 0x%lx\n", topi);
+            }
 #endif
 
             // --------------------------------- NOTE ----------------------------------------
@@ -96,7 +144,9 @@ void __attribute__((interrupt)) external_handler (void) {
 
                 // A new global interrupt has arrived. Print debug message and loop back around to handle it.
 #if DEBUG_PRINT
-                printf ("**** TOPI not zero! TOPI: 0x%lx. Another enabled & pending interrupt arrived in external handler.\n", topi);
+                if (!quiet) {
+                    printf ("**** TOPI not zero! TOPI: 0x%lx. Another enabled & pending interrupt arrived in external handler.\n", topi);
+                }
 #endif
             } else if (topi == claimi) {
 
@@ -113,8 +163,12 @@ void __attribute__((interrupt)) external_handler (void) {
 
     } while (topi != 0);
 
+    aplic_handler_dispatch_exit(hartid);
+
 #if DEBUG_PRINT
-    printf ("Exiting minor handler\n");
+    if (!quiet) {
+        printf ("Exiting minor handler\n");
+    }
 #endif
 
     external_isr_counter++; /* global to track our isr hits */
@@ -126,7 +180,8 @@ void __attribute__((interrupt)) external_handler (void) {
 }
 
 // Major handler we are using to test the SETIP method of interrupt delivery
-void __attribute__((interrupt)) set_mip_major_handler (void) {
+// Plain function called through a vector table trampoline, on the interrupt stack
+void set_mip_major_handler (void) {
 
     printf ("Set MIP major handler for interrupt ID: %d\n", INTERRUPT_ID_FOR_SET_MIP_TEST);
 
@@ -161,6 +216,9 @@ void default_exception_handler(void) {
     uint32_t mtval = read_csr(mtval);
     uint32_t code = MCAUSE_CODE(mcause);
 
+    /* Send what is queued and print the rest polled, the console lock may be held by the code that faulted */
+    console_panic();
+
     printf ("Exception Hit! mcause: 0x%08x, mepc: 0x%08x, mtval: 0x%08x\n", mcause, mepc, mtval);
     printf ("Mcause Exception Code: 0x%08x\n", code);
     printf("Now Exiting...\n");
@@ -191,7 +249,7 @@ void aplic_setip_by_num_handler () {
     printf ("APLIC SETIPNUM Handler!\n");
 
     // clear our test interrupt
-    write_word(APLIC_CLRIPNUM_0_ADDR, INTERRUPT_ID_FOR_SETIP_TEST); // clear by interrupt number
+    write_word(APLIC_INST_CLRIPNUM_ADDR(aplic_source_base(INTERRUPT_ID_FOR_SETIP_TEST)), INTERRUPT_ID_FOR_SETIP_TEST); // clear by interrupt number
 }
 
 void aplic_l2_handler() {
@@ -208,8 +266,14 @@ void aplic_beu0_handler () {
     /* Capture BEU code into global flag and clear BEU error, source of interrupt */
     beu_accrued_value = read_word (BEU0_ACCRUED_ADDR);
 
+    /* Keep the whole event, the next one overwrites beu_accrued_value */
+    beu_log_capture(0, BUSERR0_INT_NUM, read_word(BEU0_CAUSE_ADDR), read_word(BEU0_VALUE_ADDR), beu_accrued_value);
+
     /* Clear the interrupt */
     write_word(BEU0_ACCRUED_ADDR, 0);
+
+    /* Let every subscribed hart know */
+    fanout_publish(FANOUT_SRC_BEU, BUSERR0_INT_NUM, beu_accrued_value);
 #endif
 }
 
@@ -218,8 +282,14 @@ void aplic_beu1_handler () {
     /* Capture BEU code into global flag and clear BEU error, source of interrupt */
     beu_accrued_value = read_word (BEU1_ACCRUED_ADDR);
 
+    /* Keep the whole event, the next one overwrites beu_accrued_value */
+    beu_log_capture(1, BUSERR1_INT_NUM, read_word(BEU1_CAUSE_ADDR), read_word(BEU1_VALUE_ADDR), beu_accrued_value);
+
     /* Clear the interrupt */
     write_word(BEU1_ACCRUED_ADDR, 0);
+
+    /* Let every subscribed hart know */
+    fanout_publish(FANOUT_SRC_BEU, BUSERR1_INT_NUM, beu_accrued_value);
 #endif
 }
 
@@ -228,8 +298,14 @@ void aplic_beu2_handler () {
     /* Capture BEU code into global flag and clear BEU error, source of interrupt */
     beu_accrued_value = read_word (BEU2_ACCRUED_ADDR);
 
+    /* Keep the whole event, the next one overwrites beu_accrued_value */
+    beu_log_capture(2, BUSERR2_INT_NUM, read_word(BEU2_CAUSE_ADDR), read_word(BEU2_VALUE_ADDR), beu_accrued_value);
+
     /* Clear the interrupt */
     write_word(BEU2_ACCRUED_ADDR, 0);
+
+    /* Let every subscribed hart know */
+    fanout_publish(FANOUT_SRC_BEU, BUSERR2_INT_NUM, beu_accrued_value);
 #endif
 }
 
@@ -238,8 +314,14 @@ void aplic_beu3_handler () {
     /* Capture BEU code into global flag and clear BEU error, source of interrupt */
     beu_accrued_value = read_word (BEU3_ACCRUED_ADDR);
 
+    /* Keep the whole event, the next one overwrites beu_accrued_value */
+    beu_log_capture(3, BUSERR3_INT_NUM, read_word(BEU3_CAUSE_ADDR), read_word(BEU3_VALUE_ADDR), beu_accrued_value);
+
     /* Clear the interrupt */
     write_word(BEU3_ACCRUED_ADDR, 0);
+
+    /* Let every subscribed hart know */
+    fanout_publish(FANOUT_SRC_BEU, BUSERR3_INT_NUM, beu_accrued_value);
 #endif
 }
 
@@ -249,6 +331,9 @@ void aplic_beu3_handler () {
  * Recall with APLIC, that a minor interrupt can only be mapped to a single
  * hart in the system.
  *
+ * The source is programmed in the APLIC of target_hart's cluster, and made
+ * inactive in every other APLIC. See aplic_cluster.h
+ *
  * possible values of source_mode
  *    #define APLIC_SOURCECFG_MODE_INACTIVE		0
  *    #define APLIC_SOURCECFG_MODE_DETATCHED		1
@@ -260,7 +345,9 @@ void aplic_beu3_handler () {
  *****************************************************************************/
 uint32_t aplic_int_enable_disable (uint32_t target_hart, uint32_t int_id, uint32_t source_mode, uint32_t priority, uint32_t m_or_s) {
 
-    uint32_t delegate_to_s_mode;
+    uint32_t delegate_to_s_mode, i;
+    uint32_t instance = APLIC_CLUSTER_OF_HART(target_hart);
+    uintptr_t base;
 
     if (source_mode > 7) {
         printf ("APLIC SourceCfg source mode (%d) value not valid, exiting APLIC set up\n");
@@ -272,46 +359,98 @@ uint32_t aplic_int_enable_disable (uint32_t target_hart, uint32_t int_id, uint32
         return 0x8000;
     }
 
+    if (target_hart >= NUM_HARTS) {
+        printf ("Target hart: %d does not exist. Max harts is: %d\n", target_hart, NUM_HARTS);
+        return 0x8001;
+    }
+
+    // Inactive sources are disabled and never pending, so only the local APLIC can deliver this one
+    for (i = 0; i < APLIC_NUM_INSTANCES; i++) {
+        if (i != instance) {
+            write_word(APLIC_INST_SOURCECFG_ADDR(aplic_instance_base[i], int_id), APLIC_SOURCECFG_MODE_INACTIVE);
+        }
+    }
+    base = aplic_instance_base[instance];
+    aplic_source_instance[int_id] = instance;
+
     // write APLIC domainCfg.globalInterrupt=1 to enable APLIC interrupts globally
     //write_word(APLIC_DOMAINCFG_0_ADDR, APLIC_DOMAIN_CONFIG_GLOBAL_ENABLE);
     // Move this global enable outside of this function
 
     // write APLIC sourceCfg to set edge, level, detached, or inactive, and the delegation setting
     delegate_to_s_mode = ((m_or_s == MACHINE_INTS) ? APLIC_SOURCECFG_NO_DELEGATION : APLIC_SOURCECFG_DELEGATION_TO_S);
-    write_word(APLIC_SOURCECFG_0_ADDR(int_id), (source_mode | delegate_to_s_mode));
+    write_word(APLIC_INST_SOURCECFG_ADDR(base, int_id), (source_mode | delegate_to_s_mode));
 
     // write APLIC target register to set the interrupt's priority - lower number is higher priority
-    // Also, this register holds the bitfield(s) to specify which hart the interrupt will be sent to
-    write_word(APLIC_TARGET_0_0_ADDR(int_id), ((target_hart << APLIC_TARGET_HART_BIT_POSITION) | priority));
+    // Also, this register holds the bitfield(s) to specify which hart the interrupt will be sent to,
+    // as an index within the cluster of this APLIC
+    write_word(APLIC_INST_TARGET_ADDR(base, int_id), ((APLIC_LOCAL_HART(target_hart) << APLIC_TARGET_HART_BIT_POSITION) | priority));
 
     // Set the enable bit for this interrupt using SETIENUM
-    write_word(APLIC_SETIENUM_0_ADDR, int_id);
+    write_word(APLIC_INST_SETIENUM_ADDR(base), int_id);
 
-    // Check this interrupt is properly enabled using the register and bit position in SETIE register
-    if (!check_setie_by_int_num(int_id)) {
+    // Keep the RAM copy in step, queries are answered from it. See aplic_shadow.h
+    aplic_shadow_set_source(int_id, source_mode, (m_or_s != MACHINE_INTS), target_hart, priority);
+
+#if APLIC_SHADOW_CHECK
+    // Read back SETIE and the other registers, only when checking the shadow against hardware
+    if (aplic_shadow_check_source(int_id)) {
         printf ("Interrupt %d not enabled in SETIE register - check configuration!\n", int_id);
         return 0x5; 	// non-zero
-    } else {
-        return 0; 		// OK
     }
+#endif
 
     return 0;
 }
 
+/* Program the interrupt delivery control (IDC) block for one hart, in its local APLIC */
+void aplic_hart_init (uint32_t hartid, uint32_t threshold) {
+
+    uintptr_t idc = aplic_hart_idc(hartid);
+
+    // per hart IDELIVERY set to 1 to enable
+    write_word(idc + APLIC_IDC_IDELIVERY, ENABLE);
+
+    // Write the threshold value for this hart. 0 means enable all interrupts to be delivered
+    // A different example, if 0x4 is written here, then interrupts with priority 0-3 are allowed on this hart
+    // Lower the number, the higher the priority
+    write_word(idc + APLIC_IDC_ITHRESHOLD, threshold);
+
+    aplic_shadow_set_hart(hartid, ENABLE, threshold);
+}
+
+/******************************************************************************
+ * Enable a table of APLIC sources, all routed to target_hart.
+ *
+ * The table is split in parts, and only entries of the given part are
+ * programmed, so several harts can share the work at boot. Each source has
+ * its own sourcecfg and target register, so the parts never overlap.
+ * Use part 0 of 1 to program the whole table.
+ *
+ * Returns 0 if every source is enabled, otherwise the last error seen.
+ *****************************************************************************/
+uint32_t aplic_source_init (const struct aplic_source_config *config, uint32_t count, uint32_t target_hart, uint32_t part, uint32_t parts) {
+
+    uint32_t i, rc, return_code = 0;
+    uint32_t first = (count * part) / parts;
+    uint32_t last = (count * (part + 1)) / parts;
+
+    for (i = first; i < last; i++) {
+        rc = aplic_int_enable_disable (target_hart, config[i].int_id, config[i].source_mode, config[i].priority, config[i].m_or_s);
+        if (rc) {
+            return_code = rc;
+        }
+    }
+
+    return return_code;
+}
+
 /* Check the enable bit for a given APLIC minor interrupt.
+ * Answered from the RAM shadow, no MMIO read unless APLIC_SHADOW_CHECK is set.
  * Return TRUE if enabled; FALSE if not  */
 uint32_t check_setie_by_int_num(uint32_t int_id) {
 
-    // We need to figure out which SETIE_X register, and the bit position in that register for this interrupt
-    uint32_t bitshift = (int_id) % 32;	// SETIE0[1] is interrupt ID #1 for example; remainder of modulo is bit position
-    uint32_t enabled;
-
-    // The macro will return the proper base address based on interrupt ID,
-    // and then a bitwise AND is done on the return value to check the SETIE bit
-    // The result here will be 0 or 1
-    enabled = ((read_word(APLIC_SETIE_0_ADDR(int_id)) & (1 << bitshift)) >> bitshift);
-
-    return enabled;
+    return aplic_shadow_enabled(int_id);
 }
 
 /* Check the pending bit for a given APLIC minor interrupt.
@@ -325,7 +464,7 @@ uint32_t check_setip_by_int_num (uint32_t int_id) {
     // The macro will return the proper base address based on interrupt ID,
     // and then a bitwise AND is done on the return value to check the SETIE bit
     // The result here will be 0 or 1
-    pending = ((read_word(APLIC_SETIP_0_ADDR(int_id)) & (1 << bitshift)) >> bitshift);
+    pending = ((read_word(APLIC_INST_SETIP_ADDR(aplic_source_base(int_id), int_id)) & (1 << bitshift)) >> bitshift);
 
     return pending;
 }
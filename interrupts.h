@@ -11,6 +11,21 @@
 /* enable debug prints */
 #define DEBUG_PRINT            TRUE
 
+/* each hart programs its own IDC and a share of the APLIC sources at boot, see main() */
+#define PARALLEL_INIT          FALSE
+
+/* read the APLIC back on every config query and compare with the RAM shadow, see aplic_shadow.h */
+#define APLIC_SHADOW_CHECK     FALSE
+
+/* run the timer wakeup jitter benchmark, takes seconds. See jitter.h */
+#define JITTER_BENCHMARK       FALSE
+
+/* profile APLIC sources and print tuned priorities at the end, see aplic_tune.h */
+#define APLIC_TUNE             FALSE
+
+/* the core traps on misaligned loads and stores, so the test expects them to be emulated. See misaligned.h */
+#define MISALIGNED_TRAPS       FALSE
+
 /* Enable the demonstration of different interrupt delivery methods */
 #define INTERRUPT_ID_FOR_SET_MIP_TEST            16        // Use first local external interrupt to test major interrupt handling
 #define INTERRUPT_ID_FOR_SETIP_TEST              21        // test this major interrupt using SETIP by INT number. Make sure this exists in your design
@@ -26,8 +41,15 @@
 #define BEU2_PRESENT                            (METAL_SIFIVE_BUSERROR0_2_SIZE > 0)
 #define BEU3_PRESENT                            (METAL_SIFIVE_BUSERROR0_3_SIZE > 0)
 #define APLIC_PRESENT                           (METAL_SIFIVE_APLICS_0_BASE_ADDRESS > 0)
+#define UART0_PRESENT                           (METAL_SIFIVE_UART0_0_BASE_ADDRESS > 0)
 #define EC_PRESENT                              (METAL_SIFIVE_EXTENSIBLECACHE0_CACHE_SIZE > 0)
 
+/* Number of harts described by the BSP, used to size per-hart data */
+#define NUM_HARTS                               __METAL_DT_MAX_HARTS
+
+/* Per-hart data shared between harts is padded to this to avoid false sharing */
+#define CACHE_LINE_SIZE                         64
+
 /*****************************************************************************
  * This example assumes both APLIC and BEU are part of the design.
  * If one or the other doesn't exist, you may see errors.
@@ -63,6 +85,9 @@
 #if BEU3_PRESENT
 #define BUSERR3_INT_NUM        133    /* This is unique to your design - check your manual! */
 #endif
+#if UART0_PRESENT
+#define UART0_INT_NUM          3      /* This is unique to your design - check your manual! */
+#endif
 
 #if !BEU0_PRESENT
 //#error "BEU does not exist in this design - build fail!"
@@ -144,7 +169,7 @@
 
 #define DISABLE             0
 #define ENABLE              1
-#define RTC_FREQ            32768        /* Generic - this would need to change based on your implementation */
+#define RTC_FREQ            32768        /* Generic - only used if the BSP has no timebase frequency, see clocksource.c */
 #define FALSE               0
 #define TRUE                1
 
@@ -198,13 +223,13 @@
 //uint32_t bitshift = int_id_bit % 32;    // remainder is bit position
 #define APLIC_DOMAINCFG_0_ADDR                 (APLIC_BASE_ADDR + METAL_SIFIVE_APLICS_DOMAINCFG_BASE)
 #define APLIC_SOURCECFG_0_ADDR(iid)            (APLIC_BASE_ADDR + METAL_SIFIVE_APLICS_SOURCECFG_BASE + (0x4 * (iid - 1)))		// [0] is first interrupt, ID #1. 32b per interrupt ID
-#define APLIC_SETIP_0_ADDR(iid)                (APLIC_BASE_ADDR + METAL_SIFIVE_APLICS_SETIP_BASE + (0x4 * ((iid - 1) >> 5))) 	// div by 32, to get reg index to calculate offset
+#define APLIC_SETIP_0_ADDR(iid)                (APLIC_BASE_ADDR + METAL_SIFIVE_APLICS_SETIP_BASE + (0x4 * ((iid) >> 5))) 	// div by 32, to get reg index to calculate offset
 #define APLIC_SETIPNUM_0_ADDR                  (APLIC_BASE_ADDR + METAL_SIFIVE_APLICS_SETIPNUM_BASE)
-#define APLIC_CLRIP_0_ADDR(iid)                (APLIC_BASE_ADDR + METAL_SIFIVE_APLICS_IN_CLRIP_BASE + (0x4 * ((iid - 1) >> 5)))
+#define APLIC_CLRIP_0_ADDR(iid)                (APLIC_BASE_ADDR + METAL_SIFIVE_APLICS_IN_CLRIP_BASE + (0x4 * ((iid) >> 5)))
 #define APLIC_CLRIPNUM_0_ADDR                  (APLIC_BASE_ADDR + METAL_SIFIVE_APLICS_CLRIPNUM_BASE)
-#define APLIC_SETIE_0_ADDR(iid)                (APLIC_BASE_ADDR + METAL_SIFIVE_APLICS_SETIE_BASE + (0x4 * ((iid - 1) >> 5)))
+#define APLIC_SETIE_0_ADDR(iid)                (APLIC_BASE_ADDR + METAL_SIFIVE_APLICS_SETIE_BASE + (0x4 * ((iid) >> 5)))
 #define APLIC_SETIENUM_0_ADDR                  (APLIC_BASE_ADDR + METAL_SIFIVE_APLICS_SETIENUM_BASE)
-#define APLIC_CLRIE_0_ADDR(iid)                (APLIC_BASE_ADDR + METAL_SIFIVE_APLICS_CLRIE_BASE + (0x4 * ((iid - 1) >> 5)))
+#define APLIC_CLRIE_0_ADDR(iid)                (APLIC_BASE_ADDR + METAL_SIFIVE_APLICS_CLRIE_BASE + (0x4 * ((iid) >> 5)))
 #define APLIC_CLRIENUM_0_ADDR                  (APLIC_BASE_ADDR + METAL_SIFIVE_APLICS_CLRIENUM_BASE)
 #define APLIC_SETIPNUMLE_0_ADDR                (APLIC_BASE_ADDR + METAL_SIFIVE_APLICS_SETIPNUM_LE_BASE)
 #define APLIC_TARGET_0_0_ADDR(iid)             (APLIC_BASE_ADDR + METAL_SIFIVE_APLICS_TARGET_BASE + (0x4 * (iid - 1)))
@@ -259,6 +284,14 @@
 
 #define APLIC_TARGET_HART_BIT_POSITION         18
 
+/* Boot time configuration of one APLIC source, see aplic_source_init() */
+struct aplic_source_config {
+    uint32_t int_id;
+    uint32_t source_mode;
+    uint32_t priority;
+    uint32_t m_or_s;
+};
+
 #endif /* #if APLIC_PRESENT */
 
 /* different interrupt types for enables - these are just random identifiers */
@@ -314,6 +347,8 @@ int main(void);
 int other_main();
 uint32_t aplic_int_enable_disable (uint32_t target_hart, uint32_t int_id, uint32_t source_mode, uint32_t priority, uint32_t m_or_s);
 uint32_t check_setie_by_int_num(uint32_t int_id);
+void aplic_hart_init (uint32_t hartid, uint32_t threshold);
+uint32_t aplic_source_init (const struct aplic_source_config *config, uint32_t count, uint32_t target_hart, uint32_t part, uint32_t parts);
 uint32_t check_setip_by_int_num (uint32_t int_id);
 uint32_t beu_aplic_config(uint32_t error_enable);
 void interrupt_global_enable (void);
@@ -338,9 +373,9 @@ void __attribute__((interrupt)) __attribute__ ((aligned(256))) __mtvec_clint_vec
 
 /* Major interrupts */
 void __attribute__((interrupt)) software_handler (void);
-void __attribute__((interrupt)) timer_handler (void);
-void __attribute__((interrupt)) external_handler (void);
-void __attribute__((interrupt)) set_mip_major_handler (void);
+void timer_handler (void);       /* called from timer_handler_asm, see handlers.S */
+void external_handler (void);    /* called from external_handler_asm, see handlers.S */
+void set_mip_major_handler (void);  /* installed with VECTOR_TYPE_FUNC, see main() */
 void __attribute__((interrupt)) default_vector_handler (void);
 
 /* Minor handlers that are called via software in the external handler */
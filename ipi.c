@@ -0,0 +1,39 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#include "interrupts.h"
+#include "ipi.h"
+
+/* Reason bits for each hart, cleared by software_handler_asm */
+struct ipi_mailbox ipi_pending[NUM_HARTS];
+
+/* Send an IPI with a reason to every hart in hart_mask */
+void ipi_send_mask (uint32_t hart_mask, uint32_t reason) {
+
+    uint32_t i;
+
+    // data for the target is visible before the reason bit
+    for (i = 0; i < NUM_HARTS; i++) {
+        if (hart_mask & (1 << i)) {
+            __atomic_fetch_or(&ipi_pending[i].pending, reason, __ATOMIC_RELEASE);
+        }
+    }
+
+    // reason bits are visible before the MSIP writes
+    asm volatile ("fence w, o" ::: "memory");
+
+    for (i = 0; i < NUM_HARTS; i++) {
+        if (hart_mask & (1 << i)) {
+            write_word(CLINT_MSIP_ADDR_HART(i), 1);
+        }
+    }
+}
+
+void ipi_send (uint32_t hartid, uint32_t reason) {
+
+    ipi_send_mask(1 << hartid, reason);
+}
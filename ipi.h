@@ -0,0 +1,44 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#ifndef _IPI_H_
+#define _IPI_H_
+
+#include "interrupts.h"
+
+/*****************************************************************************
+ * Inter-processor interrupts with a reason.
+ *
+ * ipi_send() sets a reason bit in the target hart's ipi_pending word and
+ * raises its MSIP. software_handler_asm acts on the reasons it finds, then
+ * clears only those bits, so the sender can poll a bit to know it has been
+ * handled. A software interrupt with no reason pending is a regular one
+ * and is counted in software_isr_counter. A bare MSIP write that lands
+ * while another reason is pending can not be told apart from that IPI,
+ * so when other IPIs may be in flight send IPI_SOFTWARE instead, which is
+ * always counted.
+ *
+ * !!! Keep the reason bits in sync with handlers.S !!!
+ *****************************************************************************/
+
+#define IPI_FENCE_I                             (1 << 0)    // vector table changed, run fence.i
+#define IPI_WAKE                                (1 << 1)    // leave wfi, work is available
+#define IPI_FANOUT                              (1 << 2)    // events in the fan-out inbox, see fanout.h
+#define IPI_SOFTWARE                            (1 << 3)    // regular software interrupt, counted in software_isr_counter
+
+/* Per-hart reason bits, on their own cache line */
+struct ipi_mailbox {
+    volatile uint32_t pending;
+} __attribute__ ((aligned(CACHE_LINE_SIZE)));
+
+extern struct ipi_mailbox ipi_pending[NUM_HARTS];
+
+/* Prototypes */
+void ipi_send (uint32_t hartid, uint32_t reason);
+void ipi_send_mask (uint32_t hart_mask, uint32_t reason);
+
+#endif /* _IPI_H_ */
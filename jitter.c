@@ -0,0 +1,266 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#include "interrupts.h"
+#include "jitter.h"
+#include "timer.h"
+#include "clocksource.h"
+#include "executor.h"
+#include "ipi.h"
+#include "aplic_registry.h"
+#include "aplic_cluster.h"
+#include "aplic_shadow.h"
+#include "aplic_tune.h"
+
+struct jitter_hart jitter_hart[NUM_HARTS];
+
+/* Load buffers, one per hart so the load harts do not share lines */
+static struct {
+    volatile uint32_t words[JITTER_STREAM_BYTES / sizeof(uint32_t)];
+} __attribute__ ((aligned(CACHE_LINE_SIZE))) jitter_stream[NUM_HARTS];
+
+/* State of the current round, written by the hart in jitter_run() */
+static struct {
+    volatile uint32_t measure_hart;
+    volatile uint32_t done;                     // the measured hart has all its samples
+    volatile uint32_t checked_in;               // workers that finished the round
+    volatile uint64_t end;                      // mtime, every role gives up here
+    volatile uint32_t flood_count;
+} __attribute__ ((aligned(CACHE_LINE_SIZE))) jitter_ctl;
+
+static void jitter_flood_handler (void) {
+
+    // edge triggered source, the claim already cleared it
+    jitter_ctl.flood_count++;
+}
+
+/* Timer callback on the measured hart, entry_cycles was read first thing in timer_handler */
+static void jitter_timer_callback (uint32_t hartid, uint64_t entry_cycles) {
+
+    struct jitter_hart *j = &jitter_hart[hartid];
+    int64_t late = (int64_t)(entry_cycles - j->expected);
+    uint64_t ns = (late > 0) ? clocksource_cycles_to_ns(late) : 0;
+    uint32_t bin = ns / JITTER_BIN_NS;
+
+    j->hist[(bin < JITTER_HIST_BINS) ? bin : JITTER_HIST_BINS]++;
+    j->min_ns = (ns < j->min_ns) ? ns : j->min_ns;
+    j->max_ns = (ns > j->max_ns) ? ns : j->max_ns;
+    j->sum_ns += ns;
+    j->samples++;
+    j->fired++;
+}
+
+/* Wait for an mtime tick edge and return the mcycle value where mtime reaches deadline */
+static uint64_t jitter_deadline_cycles (uint64_t *deadline, uint64_t interval_ticks) {
+
+    uint64_t start = clocksource_read(), now, cycles;
+
+    while ((now = clocksource_read()) == start);
+    cycles = clocksource_read_cycles();
+
+    // fell behind, skip the periods that are already gone
+    while (*deadline <= now) {
+        *deadline += interval_ticks;
+    }
+
+    return cycles + ((*deadline - now) * clocksource.cycle_freq) / clocksource.mtime_freq;
+}
+
+static void jitter_measure (uint32_t hartid, const struct jitter_config *config) {
+
+    struct jitter_hart *j = &jitter_hart[hartid];
+    uint64_t interval_ticks = clocksource_us_to_ticks(config->interval_us);
+    uint64_t deadline = clocksource_read() + interval_ticks;
+    uint32_t fired;
+
+    timer_set_callback(jitter_timer_callback);
+
+    while ((j->samples < config->samples) && (clocksource_read() < jitter_ctl.end)) {
+
+        j->expected = jitter_deadline_cycles(&deadline, interval_ticks);
+        fired = j->fired;
+        timer_arm(deadline);
+
+        if (timer_wait_change(&j->fired, fired, 2 * interval_ticks) != TIMER_WAIT_OK) {
+            timer_disarm();
+            j->missed++;
+        }
+
+        deadline += interval_ticks;
+    }
+
+    timer_set_callback(NULL);
+}
+
+static void jitter_load (uint32_t hartid, const struct jitter_config *config) {
+
+    uint32_t others = (uint32_t)(((uint64_t)1 << NUM_HARTS) - 1) & ~(1 << hartid);
+    volatile uint32_t *words = jitter_stream[hartid].words;
+    uint32_t i, ready;
+
+    while (!jitter_ctl.done && (clocksource_read() < jitter_ctl.end)) {
+
+        if (config->load & JITTER_LOAD_APLIC) {
+            write_word(APLIC_INST_SETIPNUM_ADDR(aplic_source_base(JITTER_FLOOD_INT_NUM)), JITTER_FLOOD_INT_NUM);
+        }
+
+        if (config->load & JITTER_LOAD_MEMORY) {
+            for (i = 0; i < (JITTER_STREAM_BYTES / sizeof(uint32_t)); i += (CACHE_LINE_SIZE / sizeof(uint32_t))) {
+                words[i] += 1;
+            }
+        }
+
+        if (config->load & JITTER_LOAD_IPI) {
+            // at most one IPI outstanding per target, a new one only once it acknowledged the last
+            ready = 0;
+            for (i = 0; i < NUM_HARTS; i++) {
+                if ((others & (1 << i)) && !(ipi_pending[i].pending & IPI_WAKE)) {
+                    ready |= (1 << i);
+                }
+            }
+            if (ready) {
+                ipi_send_mask(ready, IPI_WAKE);
+            }
+        }
+    }
+}
+
+/* Executor work item, every hart takes the role that matches its hart ID */
+static void jitter_worker (void *arg) {
+
+    const struct jitter_config *config = arg;
+    uint32_t hartid = metal_cpu_get_current_hartid();
+
+    // a late steal after the round has ended has nothing to do
+    if (!jitter_ctl.done && (clocksource_read() < jitter_ctl.end)) {
+
+        if (hartid == jitter_ctl.measure_hart) {
+            jitter_measure(hartid, config);
+            jitter_ctl.done = TRUE;
+        } else {
+            jitter_load(hartid, config);
+        }
+    }
+
+    __atomic_fetch_add(&jitter_ctl.checked_in, 1, __ATOMIC_RELEASE);
+}
+
+/* First hart that is not measured takes the APLIC flood */
+static uint32_t jitter_flood_target (uint32_t measure_hart) {
+
+    return (measure_hart == 0) ? 1 : 0;
+}
+
+/******************************************************************************
+ * Measure timer wakeup jitter on every hart in turn, with the configured
+ * load on the others. Must be called from the boot hart with interrupts
+ * enabled, while the secondary harts are in executor_idle_loop().
+ *
+ * Returns JITTER_OK, or JITTER_ERR_CONFIG for a zero interval or sample
+ * count.
+ *****************************************************************************/
+uint32_t jitter_run (const struct jitter_config *config) {
+
+    uint32_t hartid = metal_cpu_get_current_hartid();
+    uint64_t round_us = (uint64_t)config->samples * config->interval_us * 2 + 10000;
+    uint32_t flood = (config->load & JITTER_LOAD_APLIC) && (NUM_HARTS > 1);
+    uint32_t h, i;
+
+    if ((config->interval_us == 0) || (config->samples == 0)) {
+        return JITTER_ERR_CONFIG;
+    }
+
+#if DEBUG_PRINT
+    printf ("Jitter: DEBUG_PRINT is on, the APLIC flood and IPIs print from the interrupt path\n");
+#endif
+
+    if (flood) {
+        aplic_handler_register(JITTER_FLOOD_INT_NUM, jitter_flood_handler);
+    }
+
+    for (h = 0; h < NUM_HARTS; h++) {
+
+        jitter_hart[h].min_ns = ~0ULL;
+
+        if (flood) {
+            aplic_int_enable_disable(jitter_flood_target(h), JITTER_FLOOD_INT_NUM, APLIC_SOURCECFG_MODE_RISE_EDGE,
+                                     aplic_tune_lookup(JITTER_FLOOD_INT_NUM, PRIO_THRESH_1), MACHINE_INTS);
+        }
+
+        jitter_ctl.measure_hart = h;
+        jitter_ctl.done = FALSE;
+        jitter_ctl.checked_in = 0;
+        jitter_ctl.end = clocksource_read() + clocksource_us_to_ticks(round_us);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        // one item per secondary hart. A hart stays in its item until the round ends, so each takes one
+        for (i = 0; i < NUM_HARTS - 1; i++) {
+            if (executor_submit(jitter_worker, (void *)config) != EXECUTOR_OK) {
+                printf ("Jitter: executor full, hart %d round short of workers\n", h);
+            }
+        }
+
+        jitter_worker((void *)config);
+
+        while ((__atomic_load_n(&jitter_ctl.checked_in, __ATOMIC_ACQUIRE) < NUM_HARTS) &&
+               (clocksource_read() < jitter_ctl.end));
+    }
+
+    if (flood) {
+        aplic_int_enable_disable(hartid, JITTER_FLOOD_INT_NUM, APLIC_SOURCECFG_MODE_INACTIVE,
+                                 aplic_shadow_priority(JITTER_FLOOD_INT_NUM), MACHINE_INTS);
+        aplic_handler_unregister(JITTER_FLOOD_INT_NUM);
+    }
+
+    // items no hart picked up see the round is over and return
+    while (executor_run_one(hartid));
+
+    return JITTER_OK;
+}
+
+/* Upper edge of the bin holding the given fraction of samples, max_ns if it falls in the overflow bin */
+uint64_t jitter_percentile_ns (uint32_t hartid, uint32_t parts_per_million) {
+
+    struct jitter_hart *j = &jitter_hart[hartid];
+    uint64_t rank = ((uint64_t)j->samples * parts_per_million + 999999) / 1000000;
+    uint64_t seen = 0;
+    uint32_t bin;
+
+    for (bin = 0; bin < JITTER_HIST_BINS; bin++) {
+        seen += j->hist[bin];
+        if (seen >= rank) {
+            return ((uint64_t)(bin + 1) * JITTER_BIN_NS < j->max_ns) ? (uint64_t)(bin + 1) * JITTER_BIN_NS : j->max_ns;
+        }
+    }
+
+    return j->max_ns;
+}
+
+void jitter_report (void) {
+
+    struct jitter_hart *j;
+    uint32_t h;
+
+    printf ("Timer wakeup jitter, deadline to handler entry:\n");
+    for (h = 0; h < NUM_HARTS; h++) {
+
+        j = &jitter_hart[h];
+        if (j->samples == 0) {
+            printf ("  hart %d: no samples, %d missed\n", h, j->missed);
+            continue;
+        }
+
+        printf ("  hart %d: %d samples, min %d avg %d p99.99 %d max %d ns, %d missed, %d over %d ns\n", h,
+                j->samples, (uint32_t)j->min_ns, (uint32_t)(j->sum_ns / j->samples),
+                (uint32_t)jitter_percentile_ns(h, 999900), (uint32_t)j->max_ns, j->missed,
+                j->hist[JITTER_HIST_BINS], JITTER_HIST_BINS * JITTER_BIN_NS);
+    }
+
+    if (jitter_ctl.flood_count) {
+        printf ("  %d flood interrupts taken\n", jitter_ctl.flood_count);
+    }
+}
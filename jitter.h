@@ -0,0 +1,80 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#ifndef _JITTER_H_
+#define _JITTER_H_
+
+#include "interrupts.h"
+
+/*****************************************************************************
+ * Timer wakeup jitter, in the style of cyclictest.
+ *
+ * jitter_run() measures one hart at a time. The measured hart arms
+ * mtimecmp every interval_us and sleeps. The timer callback records how
+ * long after the programmed deadline timer_handler was entered. Meanwhile
+ * the other harts run the background load selected in the config:
+ *   JITTER_LOAD_APLIC   SETIPNUM floods of JITTER_FLOOD_INT_NUM, routed to
+ *                       one of the load harts
+ *   JITTER_LOAD_MEMORY  read-modify-write passes over a private buffer
+ *   JITTER_LOAD_IPI     IPI_WAKE to every other hart, the measured one too,
+ *                       each time the target has acknowledged the last one
+ *
+ * The secondary harts pick up their role from work items given to the
+ * executor, so they must be in executor_idle_loop().
+ *
+ * Latency is measured in mcycles. Before arming, the hart waits for an
+ * mtime tick edge to extrapolate the mcycle value of the deadline, so the
+ * resolution does not depend on the mtime frequency. Samples go into a
+ * histogram of JITTER_BIN_NS wide bins, and max and p99.99 are reported
+ * per hart.
+ *
+ * A run takes about NUM_HARTS * samples * interval_us. Build with
+ * DEBUG_PRINT FALSE, or the APLIC flood will measure the UART.
+ *****************************************************************************/
+
+/* background load */
+#define JITTER_LOAD_NONE                        0
+#define JITTER_LOAD_APLIC                       (1 << 0)
+#define JITTER_LOAD_MEMORY                      (1 << 1)
+#define JITTER_LOAD_IPI                         (1 << 2)
+
+#define JITTER_FLOOD_INT_NUM                    INTERRUPT_ID_FOR_SETIP_TEST
+#define JITTER_STREAM_BYTES                     (16 * 1024)  // per load hart, make it larger than L1
+
+#define JITTER_BIN_NS                           100
+#define JITTER_HIST_BINS                        1000        // plus one overflow bin, 100 us range
+
+/* Return codes */
+#define JITTER_OK                               0
+#define JITTER_ERR_CONFIG                       0x1
+
+struct jitter_config {
+    uint32_t interval_us;
+    uint32_t samples;                           // per hart
+    uint32_t load;                              // JITTER_LOAD_* mask
+};
+
+/* Per-hart results, on their own cache lines */
+struct jitter_hart {
+    volatile uint64_t expected;                 // mcycle value of the armed deadline
+    volatile uint32_t fired;
+    uint32_t samples;
+    uint32_t missed;                            // wakeups that never came
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t sum_ns;
+    uint32_t hist[JITTER_HIST_BINS + 1];
+} __attribute__ ((aligned(CACHE_LINE_SIZE)));
+
+extern struct jitter_hart jitter_hart[NUM_HARTS];
+
+/* Prototypes */
+uint32_t jitter_run (const struct jitter_config *config);
+uint64_t jitter_percentile_ns (uint32_t hartid, uint32_t parts_per_million);
+void jitter_report (void);
+
+#endif /* _JITTER_H_ */
@@ -0,0 +1,56 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#include "interrupts.h"
+#include "misaligned.h"
+
+/* Updated from misaligned_fast in handlers.S */
+struct misaligned_pc misaligned_pcs[MISALIGNED_PC_SLOTS];
+volatile uint32_t misaligned_emulated;
+volatile uint32_t misaligned_collisions;
+
+void misaligned_reset (void) {
+
+    uint32_t i;
+
+    for (i = 0; i < MISALIGNED_PC_SLOTS; i++) {
+        misaligned_pcs[i].count = 0;
+        misaligned_pcs[i].pc = 0;
+    }
+    misaligned_emulated = 0;
+    misaligned_collisions = 0;
+}
+
+/* Print the PCs with the most emulated accesses */
+void misaligned_report (void) {
+
+    uint32_t i, n, best, printed[MISALIGNED_PC_SLOTS] = { 0 };
+
+    if (misaligned_emulated == 0) {
+        return;
+    }
+
+    printf ("Misaligned accesses emulated: %d, %d from PCs without a counter\n", misaligned_emulated, misaligned_collisions);
+
+    for (n = 0; n < MISALIGNED_REPORT_TOP; n++) {
+
+        best = MISALIGNED_PC_SLOTS;
+        for (i = 0; i < MISALIGNED_PC_SLOTS; i++) {
+            if (!printed[i] && misaligned_pcs[i].count &&
+                ((best == MISALIGNED_PC_SLOTS) || (misaligned_pcs[i].count > misaligned_pcs[best].count))) {
+                best = i;
+            }
+        }
+
+        if (best == MISALIGNED_PC_SLOTS) {
+            break;
+        }
+
+        printed[best] = TRUE;
+        printf ("  pc 0x%lx: %d\n", (unsigned long)misaligned_pcs[best].pc, misaligned_pcs[best].count);
+    }
+}
@@ -0,0 +1,57 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#ifndef _MISALIGNED_H_
+#define _MISALIGNED_H_
+
+#include "interrupts.h"
+
+/*****************************************************************************
+ * Misaligned load and store emulation.
+ *
+ * exception_entry_asm sends mcause 4 and 6 to misaligned_fast in handlers.S
+ * before exception_table[] is consulted. The access is redone with byte
+ * loads or stores at the address in mtval, the data register is read or
+ * written, and mepc moves past the instruction. Only t0 - t5 are saved and
+ * nothing is called, so a misaligned access costs a trap and a few dozen
+ * instructions.
+ *
+ * Emulated: LH, LHU, LW, SH, SW, C.LW, C.SW, C.LWSP, C.SWSP, and on RV64
+ * LWU, LD, SD, C.LD, C.SD, C.LDSP, C.SDSP. FP loads and stores and AMOs go
+ * on to exception_table[] as before. The access runs in M-mode, so it is
+ * only correct for traps taken from M-mode.
+ *
+ * Not inside trap handlers: the emulation trap overwrites mepc, mcause
+ * and mstatus.MPIE/MPP of the handler it interrupts, so that handler's
+ * mret goes back to the wrong place. Code that parses packed data in an
+ * interrupt or exception handler, e.g. an RX handler, must use byte
+ * accesses or memcpy() into an aligned copy.
+ *
+ * Every emulated access is counted in misaligned_pcs[], a direct mapped
+ * table indexed by PC, so the offending code can be found and fixed. A PC
+ * whose slot is taken by another one is only counted in
+ * misaligned_collisions.
+ *****************************************************************************/
+
+#define MISALIGNED_PC_SLOTS                     64          // power of 2, keep in sync with handlers.S
+#define MISALIGNED_REPORT_TOP                   8
+
+/* Two registers wide, handlers.S indexes it with REG_SIZE_LOG2 + 1 */
+struct misaligned_pc {
+    uintptr_t pc;                               // 0 for a free slot
+    volatile uint32_t count;
+} __attribute__ ((aligned(2 * sizeof(uintptr_t))));
+
+extern struct misaligned_pc misaligned_pcs[MISALIGNED_PC_SLOTS];
+extern volatile uint32_t misaligned_emulated;
+extern volatile uint32_t misaligned_collisions;
+
+/* Prototypes */
+void misaligned_reset (void);
+void misaligned_report (void);
+
+#endif /* _MISALIGNED_H_ */
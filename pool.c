@@ -0,0 +1,147 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#include "interrupts.h"
+#include "pool.h"
+
+/* Take a block off the global list, or a fresh one. Returns POOL_NONE if there are none */
+static uint32_t pool_global_pop (struct pool *pool) {
+
+    uint32_t old = __atomic_load_n(&pool->head, __ATOMIC_ACQUIRE);
+    uint32_t new, index;
+
+    do {
+        index = old & POOL_INDEX_MASK;
+        if (index == POOL_NONE) {
+            break;
+        }
+        // next[] of a block another hart just popped is stale, but then the tag has moved and the CAS fails
+        new = pool->next[index] | ((old + POOL_TAG_INCREMENT) & ~POOL_INDEX_MASK);
+    } while (!__atomic_compare_exchange_n(&pool->head, &old, new, TRUE, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+    if (index != POOL_NONE) {
+        return index;
+    }
+
+    if (__atomic_load_n(&pool->fresh, __ATOMIC_RELAXED) >= pool->count) {
+        return POOL_NONE;
+    }
+
+    index = __atomic_fetch_add(&pool->fresh, 1, __ATOMIC_RELAXED);
+
+    return (index < pool->count) ? index : POOL_NONE;
+}
+
+static void pool_global_push (struct pool *pool, uint32_t index) {
+
+    uint32_t old = __atomic_load_n(&pool->head, __ATOMIC_RELAXED);
+    uint32_t new;
+
+    do {
+        pool->next[index] = old & POOL_INDEX_MASK;
+        new = index | ((old + POOL_TAG_INCREMENT) & ~POOL_INDEX_MASK);
+    } while (!__atomic_compare_exchange_n(&pool->head, &old, new, TRUE, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static void pool_taken_add (struct pool *pool, uint32_t blocks) {
+
+    uint32_t taken = __atomic_add_fetch(&pool->taken, blocks, __ATOMIC_RELAXED);
+    uint32_t high = __atomic_load_n(&pool->high_water, __ATOMIC_RELAXED);
+
+    while ((taken > high) &&
+           !__atomic_compare_exchange_n(&pool->high_water, &high, taken, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+/* Allocate one block. Safe from interrupt handlers. Returns NULL if the pool is exhausted */
+void *pool_alloc (struct pool *pool) {
+
+    struct pool_cache *cache = &pool->cache[metal_cpu_get_current_hartid()];
+    uint32_t index = POOL_NONE, n = 0;
+    uintptr_t mstatus;
+
+    // a handler on this hart may use the same cache
+    __asm__ volatile ("csrrc %0, mstatus, %1" : "=r"(mstatus) : "r"(METAL_MIE_INTERRUPT));
+
+    if (cache->count == 0) {
+        while ((n < POOL_CACHE_BATCH) && ((index = pool_global_pop(pool)) != POOL_NONE)) {
+            cache->block[cache->count++] = index;
+            n++;
+        }
+        if (n) {
+            pool_taken_add(pool, n);
+        }
+    }
+
+    if (cache->count) {
+        index = cache->block[--cache->count];
+        cache->allocs++;
+    } else {
+        index = POOL_NONE;
+        cache->exhausted++;
+    }
+
+    __asm__ volatile ("csrs mstatus, %0" :: "r"(mstatus & METAL_MIE_INTERRUPT));
+
+    return (index == POOL_NONE) ? NULL : pool->storage + (index * pool->block_size);
+}
+
+/* Return a block, on any hart. Safe from interrupt handlers */
+uint32_t pool_free (struct pool *pool, void *block) {
+
+    struct pool_cache *cache = &pool->cache[metal_cpu_get_current_hartid()];
+    uintptr_t offset = (uint8_t *)block - pool->storage;
+    uintptr_t mstatus;
+    uint32_t i;
+
+    if (((uint8_t *)block < pool->storage) || (offset >= (pool->count * pool->block_size)) || (offset % pool->block_size)) {
+        return POOL_ERR_BLOCK;
+    }
+
+    __asm__ volatile ("csrrc %0, mstatus, %1" : "=r"(mstatus) : "r"(METAL_MIE_INTERRUPT));
+
+    if (cache->count == POOL_CACHE_SIZE) {
+        for (i = 0; i < POOL_CACHE_BATCH; i++) {
+            pool_global_push(pool, cache->block[--cache->count]);
+        }
+        __atomic_fetch_sub(&pool->taken, POOL_CACHE_BATCH, __ATOMIC_RELAXED);
+    }
+
+    cache->block[cache->count++] = offset / pool->block_size;
+    cache->frees++;
+
+    __asm__ volatile ("csrs mstatus, %0" :: "r"(mstatus & METAL_MIE_INTERRUPT));
+
+    return POOL_OK;
+}
+
+/* Blocks allocated and not freed yet, over all harts */
+uint32_t pool_in_use (struct pool *pool) {
+
+    uint32_t h, allocs = 0, frees = 0;
+
+    for (h = 0; h < NUM_HARTS; h++) {
+        allocs += pool->cache[h].allocs;
+        frees += pool->cache[h].frees;
+    }
+
+    return allocs - frees;
+}
+
+void pool_report (struct pool *pool) {
+
+    uint32_t h;
+
+    printf ("Pool %s: %d blocks of %d bytes, %d in use, high water %d\n", pool->name,
+            pool->count, pool->block_size, pool_in_use(pool), pool->high_water);
+
+    for (h = 0; h < NUM_HARTS; h++) {
+        if (pool->cache[h].allocs || pool->cache[h].exhausted) {
+            printf ("  hart %d: %d allocs, %d frees, %d exhausted\n", h,
+                    pool->cache[h].allocs, pool->cache[h].frees, pool->cache[h].exhausted);
+        }
+    }
+}
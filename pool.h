@@ -0,0 +1,89 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include "interrupts.h"
+
+/*****************************************************************************
+ * Fixed-size block pools, usable from interrupt handlers on any hart.
+ *
+ * pool_alloc() and pool_free() work on a small per-hart cache of free
+ * blocks, with interrupts disabled on the hart for a few instructions, so
+ * a handler can allocate while the interrupted code is in the middle of
+ * an alloc. An empty cache is refilled, and a full one flushed, by up to
+ * POOL_CACHE_BATCH blocks at a time through the global free list, a
+ * lock-free stack of block indices with a tag against ABA. Blocks never
+ * handed out yet come from a bump index, so a pool defined with
+ * POOL_DEFINE() needs no init call.
+ *
+ * Every operation is bounded, there is no lock to spin on and no path that
+ * can block.
+ *
+ * Statistics: allocs, frees and failed allocs per hart, and the high-water
+ * mark of blocks taken from the global list. Blocks sitting in a hart's
+ * cache count as taken, so the mark is at most
+ * NUM_HARTS * POOL_CACHE_SIZE above the real use.
+ *****************************************************************************/
+
+#define POOL_CACHE_SIZE                         8
+#define POOL_CACHE_BATCH                        4           // blocks moved per refill or flush
+#define POOL_MAX_BLOCKS                         0xFFFF
+
+#define POOL_NONE                               0xFFFF      // empty global list
+#define POOL_INDEX_MASK                         0xFFFF
+#define POOL_TAG_INCREMENT                      0x10000
+
+#define POOL_ALIGN(size)                        (((size) + 7) & ~7)
+
+/* Return codes */
+#define POOL_OK                                 0
+#define POOL_ERR_BLOCK                          0x1         // not a block of this pool
+
+/* Per-hart cache, on its own cache line. Only its hart touches it */
+struct pool_cache {
+    uint16_t count;
+    uint16_t block[POOL_CACHE_SIZE];
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t exhausted;                         // allocs that found no block
+} __attribute__ ((aligned(CACHE_LINE_SIZE)));
+
+struct pool {
+    const char *name;
+    uint8_t *storage;
+    volatile uint16_t *next;                    // next free block after each block on the global list
+    uint32_t block_size;
+    uint32_t count;
+    volatile uint32_t head __attribute__ ((aligned(CACHE_LINE_SIZE)));   // index in [15:0], tag in [31:16]
+    volatile uint32_t fresh;                    // blocks handed out by the bump index
+    volatile uint32_t taken;                    // blocks off the global list
+    volatile uint32_t high_water;
+    struct pool_cache cache[NUM_HARTS];
+};
+
+/* Define a pool of count blocks of block_size bytes, 8 byte aligned */
+#define POOL_DEFINE(pool_name, size, blocks)                                                        \
+    static uint8_t pool_name##_storage[(blocks) * POOL_ALIGN(size)] __attribute__ ((aligned(8)));   \
+    static volatile uint16_t pool_name##_next[blocks];                                              \
+    struct pool pool_name = {                                                                       \
+        .name = #pool_name,                                                                         \
+        .storage = pool_name##_storage,                                                             \
+        .next = pool_name##_next,                                                                   \
+        .block_size = POOL_ALIGN(size),                                                             \
+        .count = (blocks),                                                                          \
+        .head = POOL_NONE,                                                                          \
+    }
+
+/* Prototypes */
+void *pool_alloc (struct pool *pool);
+uint32_t pool_free (struct pool *pool, void *block);
+uint32_t pool_in_use (struct pool *pool);
+void pool_report (struct pool *pool);
+
+#endif /* _POOL_H_ */
@@ -0,0 +1,145 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#include "interrupts.h"
+#include "timer.h"
+#include "clocksource.h"
+
+/* Per-hart deadlines in mtime ticks, TIMER_DISARMED when not in use */
+volatile uint64_t timer_app_deadline[NUM_HARTS] = { [0 ... NUM_HARTS - 1] = TIMER_DISARMED };
+volatile uint64_t timer_wait_deadline[NUM_HARTS] = { [0 ... NUM_HARTS - 1] = TIMER_DISARMED };
+
+/* Per-hart application deadline callbacks, NULL to count expiries in timer_isr_counter */
+static timer_callback_t timer_app_callback[NUM_HARTS];
+
+/* Write mtimecmp without creating a transient compare value lower than the old or new one */
+void timer_write_mtimecmp (uint32_t hartid, uint64_t value) {
+
+#if __riscv_xlen == 32
+    write_word(CLINT_MTIMECMP_ADDR_HART(hartid), 0xFFFFFFFF);                  // no smaller than old value
+    write_word(CLINT_MTIMECMP_ADDR_HART(hartid) + 4, (uint32_t)(value >> 32)); // no smaller than new value
+    write_word(CLINT_MTIMECMP_ADDR_HART(hartid), (uint32_t)value);             // new value
+#else
+    write_dword(CLINT_MTIMECMP_ADDR_HART(hartid), value);
+#endif
+
+    asm ("fence ow, ow");   // system IO release to sync the mtimecmp write. This prevents spurious interrupts
+}
+
+/* Program mtimecmp with the earliest deadline for this hart. Called with interrupts disabled */
+static void timer_program (uint32_t hartid) {
+
+    uint64_t app = timer_app_deadline[hartid];
+    uint64_t wait = timer_wait_deadline[hartid];
+
+    timer_write_mtimecmp(hartid, (app < wait) ? app : wait);
+}
+
+/* Arm the application timer for this hart, timer_handler counts it when it expires */
+void timer_arm (uint64_t deadline) {
+
+    uint32_t hartid = metal_cpu_get_current_hartid();
+    uintptr_t mstatus;
+
+    __asm__ volatile ("csrrc %0, mstatus, %1" : "=r"(mstatus) : "r"(METAL_MIE_INTERRUPT));
+    timer_app_deadline[hartid] = deadline;
+    timer_program(hartid);
+    __asm__ volatile ("csrs mstatus, %0" :: "r"(mstatus & METAL_MIE_INTERRUPT));
+}
+
+void timer_disarm (void) {
+
+    timer_arm(TIMER_DISARMED);
+}
+
+/* Send this hart's application deadlines to callback, or back to the counter with NULL */
+void timer_set_callback (timer_callback_t callback) {
+
+    timer_app_callback[metal_cpu_get_current_hartid()] = callback;
+}
+
+/* Called from timer_handler, with mcycle read on entry. Disarms expired deadlines and reprograms mtimecmp.
+ * Returns TRUE if the application deadline expired and has no callback; FALSE otherwise */
+uint32_t timer_service (uint32_t hartid, uint64_t entry_cycles) {
+
+    uint64_t now = clocksource_read();
+    uint32_t app_expired = FALSE;
+
+    if (timer_app_deadline[hartid] <= now) {
+        timer_app_deadline[hartid] = TIMER_DISARMED;
+
+        if (timer_app_callback[hartid]) {
+            timer_app_callback[hartid](hartid, entry_cycles);
+        } else {
+            app_expired = TRUE;
+        }
+    }
+
+    // the waiting hart checks mtime itself, just stop the interrupt here
+    if (timer_wait_deadline[hartid] <= now) {
+        timer_wait_deadline[hartid] = TIMER_DISARMED;
+    }
+
+    timer_program(hartid);
+
+    return app_expired;
+}
+
+/******************************************************************************
+ * Sleep in wfi until *flag no longer reads initial, or timeout_ticks of mtime
+ * have passed. The machine timer interrupt is enabled for the duration of the
+ * wait so the deadline can wake the hart up.
+ *
+ * Interrupts are disabled around the flag check and wfi. wfi still wakes up
+ * on a pending interrupt, which is then taken in the short window where
+ * mstatus.mie is set, so a flag change can never be missed before sleeping.
+ *
+ * Returns TIMER_WAIT_OK if the flag changed, TIMER_WAIT_TIMEOUT otherwise.
+ *****************************************************************************/
+uint32_t timer_wait_change (volatile uint32_t *flag, uint32_t initial, uint64_t timeout_ticks) {
+
+    uint32_t hartid = metal_cpu_get_current_hartid();
+    uint64_t deadline = clocksource_read() + timeout_ticks;
+    uint32_t return_code = TIMER_WAIT_OK;
+    uintptr_t mstatus, mie;
+
+    __asm__ volatile ("csrrc %0, mstatus, %1" : "=r"(mstatus) : "r"(METAL_MIE_INTERRUPT));
+    __asm__ volatile ("csrrs %0, mie, %1" : "=r"(mie) : "r"(METAL_LOCAL_INTERRUPT_TMR));
+
+    timer_wait_deadline[hartid] = deadline;
+    timer_program(hartid);
+
+    while (*flag == initial) {
+
+        if (clocksource_read() >= deadline) {
+            return_code = TIMER_WAIT_TIMEOUT;
+            break;
+        }
+
+        asm volatile ("wfi");
+
+        // open a window to take the interrupt that woke us up
+        interrupt_global_enable();
+        interrupt_global_disable();
+    }
+
+    timer_wait_deadline[hartid] = TIMER_DISARMED;
+    timer_program(hartid);
+
+    // restore the timer enable and mstatus.mie as they were on entry
+    if (!(mie & METAL_LOCAL_INTERRUPT_TMR)) {
+        interrupt_timer_disable();
+    }
+    __asm__ volatile ("csrs mstatus, %0" :: "r"(mstatus & METAL_MIE_INTERRUPT));
+
+    return return_code;
+}
+
+uint32_t timer_wait_change_us (volatile uint32_t *flag, uint32_t initial, uint32_t timeout_us) {
+
+    return timer_wait_change(flag, initial, clocksource_us_to_ticks(timeout_us));
+}
@@ -0,0 +1,53 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#include "interrupts.h"
+
+/*****************************************************************************
+ * Per-hart machine timer deadlines and mtime based waits.
+ *
+ * Each hart has one mtimecmp, shared here by two deadlines:
+ *  - the application deadline, armed with timer_arm(), which increments
+ *    timer_isr_counter in timer_handler when it expires
+ *  - the wait deadline, armed by timer_wait_change() to bound a wait
+ * mtimecmp is always programmed with the earlier of the two.
+ *
+ * A hart can set a callback with timer_set_callback(). Its application
+ * deadlines then go to the callback, with mcycle read on entry to
+ * timer_handler, instead of being counted.
+ *
+ * timer_wait_change() sleeps in wfi until the flag changes or the deadline
+ * passes, so the hart does not poll the bus while it waits. The flag must be
+ * changed from an interrupt handler taken on the waiting hart, otherwise the
+ * change is only seen when the deadline wakes the hart up.
+ *****************************************************************************/
+
+#define TIMER_DISARMED                  0xFFFFFFFFFFFFFFFFULL
+
+/* Default timeout for the waits in main() */
+#define TIMER_WAIT_TIMEOUT_US           10000
+
+/* Return codes */
+#define TIMER_WAIT_OK                   0
+#define TIMER_WAIT_TIMEOUT              0x1
+
+/* Called from timer_handler when the application deadline of the hart expires */
+typedef void (*timer_callback_t)(uint32_t hartid, uint64_t entry_cycles);
+
+/* Prototypes */
+void timer_write_mtimecmp (uint32_t hartid, uint64_t value);
+void timer_arm (uint64_t deadline);
+void timer_disarm (void);
+void timer_set_callback (timer_callback_t callback);
+uint32_t timer_service (uint32_t hartid, uint64_t entry_cycles);
+uint32_t timer_wait_change (volatile uint32_t *flag, uint32_t initial, uint64_t timeout_ticks);
+uint32_t timer_wait_change_us (volatile uint32_t *flag, uint32_t initial, uint32_t timeout_us);
+
+#endif /* _TIMER_H_ */
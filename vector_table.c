@@ -0,0 +1,205 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#include "interrupts.h"
+#include "vector_table.h"
+#include "clocksource.h"
+#include "ipi.h"
+
+/* Far targets called by the trampolines in handlers.S, indexed by IRQ */
+uintptr_t vector_far_targets[VECTOR_TABLE_ENTRIES];
+
+/* Bitmask of harts that can take a software interrupt to sync their I-cache */
+volatile uint32_t vector_table_online_mask = 0;
+
+/* Opcodes from handlers.S of the slots patched so far, restored by vector_table_uninstall() */
+static uint32_t vector_table_original[VECTOR_TABLE_ENTRIES];
+static uint64_t vector_table_saved_mask = 0;
+
+#ifndef VECTOR_TABLE_RAM_START
+/* Set up by the freedom-metal linker scripts. Weak, so a custom script without them links and patching is refused */
+extern char metal_segment_data_source_start[] __attribute__ ((weak));
+extern char metal_segment_data_target_start[] __attribute__ ((weak));
+extern char metal_segment_stack_end[] __attribute__ ((weak));
+#endif
+
+/* TRUE if the vector table is in RAM, checked before any store to it. Flash faults on a store */
+static uint32_t vector_table_writable (void) {
+
+    uintptr_t table = (uintptr_t)&__mtvec_clint_vector_table;
+
+#ifdef VECTOR_TABLE_RAM_START
+    return (table >= VECTOR_TABLE_RAM_START) && ((table + (VECTOR_TABLE_ENTRIES * 4)) <= VECTOR_TABLE_RAM_END);
+#else
+    // .data is copied out of flash at boot unless the whole program was loaded into RAM.
+    // Only the span from .data to the end of the stack is known to be RAM, flash may sit below it
+    if ((metal_segment_data_target_start == NULL) || (metal_segment_stack_end == NULL)) {
+        return FALSE;
+    }
+
+    return ((uintptr_t)metal_segment_data_source_start == (uintptr_t)metal_segment_data_target_start) &&
+           (table >= (uintptr_t)metal_segment_data_target_start) &&
+           ((table + (VECTOR_TABLE_ENTRIES * 4)) <= (uintptr_t)metal_segment_stack_end);
+#endif
+}
+
+/* Encode "jal x0, offset" - the "j" pseudo instruction */
+static uint32_t vector_table_encode_j (intptr_t offset) {
+
+    uint32_t imm = (uint32_t)offset;
+
+    return (((imm >> 20) & 0x1) << 31) |       // imm[20]
+           (((imm >> 1) & 0x3FF) << 21) |      // imm[10:1]
+           (((imm >> 11) & 0x1) << 20) |       // imm[11]
+           (((imm >> 12) & 0xFF) << 12) |      // imm[19:12]
+           OPCODE_JAL;                          // rd = x0
+}
+
+/* Write an opcode into a vector table slot and make it visible to every hart */
+static uint32_t vector_table_write_opcode (uint32_t irq, uint32_t opcode) {
+
+    uintptr_t slot = (uintptr_t)&__mtvec_clint_vector_table + (irq * 4);
+
+    if (!vector_table_writable()) {
+#if DEBUG_PRINT
+        printf ("Vector table at 0x%lx is not in RAM - link with .text in RAM\n", (unsigned long)&__mtvec_clint_vector_table);
+#endif
+        return VECTOR_TABLE_ERR_READ_ONLY;
+    }
+
+    // keep the entry from handlers.S, so uninstall puts it back
+    if (!(vector_table_saved_mask & (1ULL << irq))) {
+        vector_table_original[irq] = read_word(slot);
+        vector_table_saved_mask |= (1ULL << irq);
+    }
+
+    // A naturally aligned 32-bit store, so a fetch sees either the old or the new opcode
+    write_word(slot, opcode);
+
+    if (read_word(slot) != opcode) {
+        return VECTOR_TABLE_ERR_READ_ONLY;
+    }
+
+    return vector_table_icache_sync();
+}
+
+/* Write a "j target" opcode into a vector table slot */
+static uint32_t vector_table_write_slot (uint32_t irq, uintptr_t target) {
+
+    uintptr_t slot = (uintptr_t)&__mtvec_clint_vector_table + (irq * 4);
+    intptr_t offset = (intptr_t)target - (intptr_t)slot;
+
+    if ((offset > JAL_MAX_OFFSET) || (offset < JAL_MIN_OFFSET)) {
+        return VECTOR_TABLE_ERR_RANGE;
+    }
+
+    return vector_table_write_opcode(irq, vector_table_encode_j(offset));
+}
+
+/******************************************************************************
+ * Install a major interrupt handler into the CLINT vector table.
+ *
+ * possible values of type
+ *    #define VECTOR_TYPE_ISR     - __attribute__((interrupt)) handler, jumped
+ *                                  to directly from the vector table slot
+ *    #define VECTOR_TYPE_FUNC    - plain C function, called through the
+ *                                  trampoline for this IRQ in handlers.S
+ *
+ * IRQ 0 is the exception entry and cannot be replaced here.
+ *
+ *****************************************************************************/
+uint32_t vector_table_install (uint32_t irq, void (*handler)(void), uint32_t type) {
+
+    uintptr_t trampoline;
+    uint32_t rc;
+
+    if ((irq == 0) || (irq >= VECTOR_TABLE_ENTRIES)) {
+        printf ("Vector table IRQ %d is not valid, range is 1 - %d\n", irq, VECTOR_TABLE_ENTRIES - 1);
+        return VECTOR_TABLE_ERR_IRQ;
+    }
+
+    switch (type)
+    {
+        case VECTOR_TYPE_ISR:
+            rc = vector_table_write_slot(irq, (uintptr_t)handler);
+            if (rc == VECTOR_TABLE_ERR_RANGE) {
+                printf ("Handler 0x%lx is out of reach of IRQ %d, use VECTOR_TYPE_FUNC\n", (unsigned long)handler, irq);
+            }
+            return rc;
+
+        case VECTOR_TYPE_FUNC:
+            // publish the target before the slot can jump to the trampoline
+            vector_far_targets[irq] = (uintptr_t)handler;
+            asm volatile ("fence w, w");
+
+            trampoline = (uintptr_t)__vector_trampolines + (irq * VECTOR_TRAMPOLINE_SIZE);
+            return vector_table_write_slot(irq, trampoline);
+
+        default:
+            return VECTOR_TABLE_ERR_TYPE;
+    }
+}
+
+/* Put back the entry handlers.S has for a slot. Nothing to do if it was never patched */
+uint32_t vector_table_uninstall (uint32_t irq) {
+
+    if ((irq == 0) || (irq >= VECTOR_TABLE_ENTRIES)) {
+        return VECTOR_TABLE_ERR_IRQ;
+    }
+
+    if (!(vector_table_saved_mask & (1ULL << irq))) {
+        return VECTOR_TABLE_OK;
+    }
+
+    return vector_table_write_opcode(irq, vector_table_original[irq]);
+}
+
+/* Sync the I-cache of this hart and every other online hart after the vector table changes.
+ * Must be called with interrupts enabled on the other harts, not from a handler. */
+uint32_t vector_table_icache_sync (void) {
+
+    uint32_t hartid = metal_cpu_get_current_hartid();
+    uint64_t deadline;
+    uint32_t mask, i;
+
+    asm volatile ("fence.i");
+
+    // opcode stores must be visible before we sample the online harts, and before any hart sees its request
+    asm volatile ("fence rw, rw");
+
+    mask = vector_table_online_mask & ~(1 << hartid);
+    if (mask == 0) {
+        return VECTOR_TABLE_OK;
+    }
+
+    ipi_send_mask(mask, IPI_FENCE_I);
+
+    // wait for software_handler_asm on every hart to fence.i and clear its request.
+    // Other harts clear the requests, so poll against an mtime deadline rather than sleeping
+    deadline = clocksource_read() + clocksource_us_to_ticks(VECTOR_TABLE_SYNC_TIMEOUT_US);
+    for (i = 0; i < NUM_HARTS; i++) {
+        while ((mask & (1 << i)) && (ipi_pending[i].pending & IPI_FENCE_I) && (clocksource_read() < deadline));
+
+        if ((mask & (1 << i)) && (ipi_pending[i].pending & IPI_FENCE_I)) {
+            printf ("Hart %d did not sync its I-cache for the vector table!\n", i);
+            return VECTOR_TABLE_ERR_SYNC_TIMEOUT;
+        }
+    }
+
+    return VECTOR_TABLE_OK;
+}
+
+/* Called by each hart once it takes software interrupts, so it is included in I-cache syncs */
+void vector_table_hart_online (void) {
+
+    uint32_t hartid = metal_cpu_get_current_hartid();
+
+    __atomic_fetch_or(&vector_table_online_mask, (1 << hartid), __ATOMIC_SEQ_CST);
+
+    // drop any vector table lines fetched before a patching hart could see us online
+    asm volatile ("fence.i");
+}
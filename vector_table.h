@@ -0,0 +1,77 @@
+/* Copyright 2020 SiFive, Inc */
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <metal/machine.h>
+
+#ifndef _VECTOR_TABLE_H_
+#define _VECTOR_TABLE_H_
+
+#include "interrupts.h"
+
+/*****************************************************************************
+ * Runtime patching of the CLINT vector table in handlers.S.
+ *
+ * Each entry of __mtvec_clint_vector_table is a single "j handler" opcode.
+ * vector_table_install() re-encodes that opcode at runtime so a major
+ * interrupt lands directly in its handler, with the same latency as an
+ * entry written in handlers.S.
+ *
+ * A "j" reaches +/- 1 MiB. Handlers further away (or plain C functions that
+ * are not __attribute__((interrupt))) are reached through a trampoline in
+ * handlers.S, which saves the caller-saved registers, calls the function
+ * and executes mret. Interrupt-attribute handlers must be within reach of
+ * a "j", since no register is free to build a far jump on trap entry.
+ * Trampolines run on the interrupt stack of the hart (interrupt_stack.h),
+ * interrupt-attribute handlers on the stack of the interrupted code.
+ *
+ * Patching is additive: every entry in handlers.S stays a working handler,
+ * and vector_table_uninstall() puts back the opcode handlers.S had.
+ *
+ * The vector table must live in writable memory, so link with a target that
+ * loads the whole program into RAM (scratchpad). Before the first store,
+ * the table is checked to lie between the start of .data and the end of
+ * the stack, with .data not copied from flash, or against
+ * VECTOR_TABLE_RAM_START and VECTOR_TABLE_RAM_END if the build defines
+ * them. Install returns VECTOR_TABLE_ERR_READ_ONLY rather than fault on
+ * flash. The freedom-metal scripts put .text below .data, so a scratchpad
+ * build that patches the table defines the RAM bounds. The patching hart does a local fence.i, then
+ * sends an IPI_FENCE_I to every other hart that called
+ * vector_table_hart_online(), and waits for them to fence.i as well.
+ *****************************************************************************/
+
+#define VECTOR_TABLE_ENTRIES                    64        // matches IRQ_0 - IRQ_63 in handlers.S
+#define VECTOR_TRAMPOLINE_SIZE                  24        // bytes per trampoline in handlers.S, 6 opcodes
+
+/* handler types for vector_table_install() */
+#define VECTOR_TYPE_ISR                         0x1       // __attribute__((interrupt)) handler, ends in mret
+#define VECTOR_TYPE_FUNC                        0x2       // plain C function, called through a trampoline
+
+/* jal x0, offset opcode helpers */
+#define OPCODE_JAL                              0x6F
+#define JAL_MAX_OFFSET                          ((1 << 20) - 2)
+#define JAL_MIN_OFFSET                          (-(1 << 20))
+
+/* Time to wait for other harts to sync their I-cache */
+#define VECTOR_TABLE_SYNC_TIMEOUT_US            1000
+
+/* Return codes */
+#define VECTOR_TABLE_OK                         0
+#define VECTOR_TABLE_ERR_IRQ                    0x1       // IRQ 0 is the exception entry, or IRQ out of range
+#define VECTOR_TABLE_ERR_TYPE                   0x2
+#define VECTOR_TABLE_ERR_RANGE                  0x3       // ISR is out of "j" range
+#define VECTOR_TABLE_ERR_READ_ONLY              0x4       // table is not in RAM, or the opcode did not stick
+#define VECTOR_TABLE_ERR_SYNC_TIMEOUT           0x5       // a hart did not acknowledge the fence.i request
+
+/* Trampoline table from handlers.S, and the far targets it calls */
+extern uint32_t __vector_trampolines[];
+extern uintptr_t vector_far_targets[VECTOR_TABLE_ENTRIES];
+
+/* Prototypes */
+uint32_t vector_table_install (uint32_t irq, void (*handler)(void), uint32_t type);
+uint32_t vector_table_uninstall (uint32_t irq);
+uint32_t vector_table_icache_sync (void);
+void vector_table_hart_online (void);
+
+#endif /* _VECTOR_TABLE_H_ */